@@ -0,0 +1,46 @@
+#include "AerialPerspectiveVolumeComponent.h"
+
+#include "Engine/TextureRenderTargetVolume.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "SweetAtmosphereShaders/Public/Rendering/AtmosphereSceneViewExtension.h"
+
+void UAerialPerspectiveVolumeComponent::BindToMaterial(UMaterialInstanceDynamic* Material) const
+{
+	if (!Material)
+	{
+		return;
+	}
+
+	Material->SetTextureParameterValue("AerialPerspectiveVolume", VolumeTexture);
+	Material->SetScalarParameterValue("AerialPerspectiveMaxDistance", MaxDistance);
+}
+
+void UAerialPerspectiveVolumeComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	if (!VolumeTexture)
+	{
+		VolumeTexture = NewObject<UTextureRenderTargetVolume>(this, NAME_None, RF_Transient);
+		VolumeTexture->bCanCreateUAV = true;
+		VolumeTexture->ClearColor = FLinearColor(0, 0, 0, 1);
+	}
+	VolumeTexture->Init(
+		FMath::Max(1, Resolution.X),
+		FMath::Max(1, Resolution.Y),
+		FMath::Max(1, Resolution.Z),
+		PF_FloatRGBA);
+	VolumeTexture->UpdateResourceImmediate(true);
+
+	FAtmosphereSceneViewExtension::Get()->SetAerialPerspectiveVolume(VolumeTexture, MaxDistance);
+}
+
+void UAerialPerspectiveVolumeComponent::OnUnregister()
+{
+	if (VolumeTexture)
+	{
+		FAtmosphereSceneViewExtension::Get()->RemoveAerialPerspectiveVolume(VolumeTexture);
+	}
+
+	Super::OnUnregister();
+}
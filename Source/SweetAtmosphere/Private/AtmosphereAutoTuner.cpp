@@ -0,0 +1,403 @@
+#include "AtmosphereAutoTuner.h"
+
+#include "AtmospherePrecompute.h"
+#include "AtmosphereQuery.h"
+#include "AtmosphereResidencySubsystem.h"
+#include "SweetAtmosphereShaders/Public/Precompute/PrecomputeScheduler.h"
+#include "Tasks/Task.h"
+
+/**
+ * The largest amount of reference texels compared along each axis of a 2D and 3D texture.
+ */
+static constexpr int32 MaxSamplesPerAxis2D = 128;
+static constexpr int32 MaxSamplesPerAxis3D = 48;
+
+/**
+ * The values FAtmosphereAutoTuner reduces, in the order candidates are created.
+ */
+enum class EAutoTuneValue : uint8
+{
+	TransmittanceWidth,
+	TransmittanceHeight,
+	InScatteredLightHeight,
+	InScatteredLightViewAngle,
+	InScatteredLightSunAngle,
+	TransmittanceSampleSteps,
+	InScatteredLightSampleSteps,
+	Num
+};
+
+static int& GetValue(FPrecomputedTextureSettings& Settings, const EAutoTuneValue Value)
+{
+	switch (Value)
+	{
+		case EAutoTuneValue::TransmittanceWidth:
+			return Settings.TransmittanceTextureWidth;
+		case EAutoTuneValue::TransmittanceHeight:
+			return Settings.TransmittanceTextureHeight;
+		case EAutoTuneValue::InScatteredLightHeight:
+			return Settings.InScatteredLightTextureDimensions.X;
+		case EAutoTuneValue::InScatteredLightViewAngle:
+			return Settings.InScatteredLightTextureDimensions.Y;
+		case EAutoTuneValue::InScatteredLightSunAngle:
+			return Settings.InScatteredLightTextureDimensions.Z;
+		case EAutoTuneValue::TransmittanceSampleSteps:
+			return Settings.TransmittanceSampleSteps;
+		default:
+			return Settings.InScatteredLightSampleSteps;
+	}
+}
+
+static bool IsSampleSteps(const EAutoTuneValue Value)
+{
+	return Value == EAutoTuneValue::TransmittanceSampleSteps || Value == EAutoTuneValue::InScatteredLightSampleSteps;
+}
+
+/**
+ * Reference texels to compare candidates against, at their texture coordinates.
+ */
+struct FAutoTuneReference
+{
+	TArray<FVector2f> TransmittanceUVs;
+	TArray<FLinearColor> TransmittanceValues;
+	float TransmittancePeak = 0;
+
+	TArray<FVector3f> InScatteredLightUVWs;
+	TArray<FLinearColor> InScatteredLightValues;
+	float InScatteredLightPeak = 0;
+};
+
+struct FAutoTuneCandidate
+{
+	FPrecomputedTextureSettings Settings;
+	float TransmittanceError = 0;
+	float InScatteredLightError = 0;
+
+	/**
+	 * Whether the candidate couldn't be precomputed, in which case it is never chosen.
+	 */
+	bool Failed = false;
+
+	float GetError() const
+	{
+		return FMath::Max(TransmittanceError, InScatteredLightError);
+	}
+};
+
+static FLinearColor ReadTexel(const FTextureData& TextureData, const int32 Index)
+{
+	check(TextureData.PixelFormat == PF_FloatRGBA);
+	return FLinearColor(reinterpret_cast<const FFloat16Color*>(TextureData.Data.GetData())[Index]);
+}
+
+static float GetPeak(const TArray<FLinearColor>& Values)
+{
+	float Peak = 0;
+	for (const FLinearColor& Value : Values)
+	{
+		Peak = FMath::Max(Peak, Value.GetMax());
+	}
+	return Peak;
+}
+
+static FAutoTuneReference CreateReference(const FAtmospherePrecomputedTextureData& TextureData)
+{
+	FAutoTuneReference Reference;
+
+	// texel i holds the value precomputed for uv = i / Size
+	const FIntVector TransmittanceSize = TextureData.TransmittanceTextureData.Size;
+	const int32 TransmittanceStrideX = FMath::Max(1, TransmittanceSize.X / MaxSamplesPerAxis2D);
+	const int32 TransmittanceStrideY = FMath::Max(1, TransmittanceSize.Y / MaxSamplesPerAxis2D);
+	for (int32 y = 0; y < TransmittanceSize.Y; y += TransmittanceStrideY)
+	{
+		for (int32 x = 0; x < TransmittanceSize.X; x += TransmittanceStrideX)
+		{
+			Reference.TransmittanceUVs.Add(FVector2f(float(x) / TransmittanceSize.X, float(y) / TransmittanceSize.Y));
+			Reference.TransmittanceValues.Add(ReadTexel(TextureData.TransmittanceTextureData, y * TransmittanceSize.X + x));
+		}
+	}
+
+	const FIntVector InScatteredLightSize = TextureData.InScatteredLightTextureData.Size;
+	if (InScatteredLightSize.Z > 0)
+	{
+		const FIntVector Stride(
+			FMath::Max(1, InScatteredLightSize.X / MaxSamplesPerAxis3D),
+			FMath::Max(1, InScatteredLightSize.Y / MaxSamplesPerAxis3D),
+			FMath::Max(1, InScatteredLightSize.Z / MaxSamplesPerAxis3D));
+		for (int32 z = 0; z < InScatteredLightSize.Z; z += Stride.Z)
+		{
+			for (int32 y = 0; y < InScatteredLightSize.Y; y += Stride.Y)
+			{
+				for (int32 x = 0; x < InScatteredLightSize.X; x += Stride.X)
+				{
+					Reference.InScatteredLightUVWs.Add(FVector3f(FVector3f(x, y, z) / FVector3f(InScatteredLightSize)));
+					Reference.InScatteredLightValues.Add(ReadTexel(TextureData.InScatteredLightTextureData,
+						(z * InScatteredLightSize.Y + y) * InScatteredLightSize.X + x));
+				}
+			}
+		}
+	}
+	else
+	{
+		// outer shell textures only have a view angle (x) and sun angle (y) axis
+		const int32 StrideX = FMath::Max(1, InScatteredLightSize.X / MaxSamplesPerAxis2D);
+		const int32 StrideY = FMath::Max(1, InScatteredLightSize.Y / MaxSamplesPerAxis2D);
+		for (int32 y = 0; y < InScatteredLightSize.Y; y += StrideY)
+		{
+			for (int32 x = 0; x < InScatteredLightSize.X; x += StrideX)
+			{
+				Reference.InScatteredLightUVWs.Add(FVector3f(1, float(x) / InScatteredLightSize.X, float(y) / InScatteredLightSize.Y));
+				Reference.InScatteredLightValues.Add(ReadTexel(TextureData.InScatteredLightTextureData, y * InScatteredLightSize.X + x));
+			}
+		}
+	}
+
+	Reference.TransmittancePeak = GetPeak(Reference.TransmittanceValues);
+	Reference.InScatteredLightPeak = GetPeak(Reference.InScatteredLightValues);
+	return Reference;
+}
+
+/**
+ * @return The root mean square difference of the samples to the reference values, relative to the reference peak.
+ */
+template <typename UVType, typename SampleType>
+static float ComputeError(const TArray<UVType>& UVs, const TArray<FLinearColor>& Values, const float Peak, const SampleType& Sample)
+{
+	if (UVs.IsEmpty() || Peak <= 0)
+	{
+		return 0;
+	}
+
+	double SumSquaredDifference = 0;
+	for (int32 i = 0; i < UVs.Num(); i++)
+	{
+		const FLinearColor Difference = Sample(UVs[i]) - Values[i];
+		SumSquaredDifference += FMath::Square(Difference.R) + FMath::Square(Difference.G) + FMath::Square(Difference.B);
+	}
+	return FMath::Sqrt(SumSquaredDifference / (3 * UVs.Num())) / Peak;
+}
+
+/**
+ * Precomputes the candidate and compares it to the reference once it has been read back.
+ */
+static UE::Tasks::TTask<FAutoTuneCandidate> EvaluateCandidate(
+	const FPrecomputedTextureSettings& Settings,
+	const FAtmosphereSettings& AtmosphereSettings,
+	const TSharedRef<const FAutoTuneReference, ESPMode::ThreadSafe>& Reference)
+{
+	const auto Precompute = FAtmospherePrecomputeShaderDispatcher::LaunchTask(
+		Settings, CreatePrecomputeContext(Settings, AtmosphereSettings), false);
+
+	return UE::Tasks::Launch(
+		TEXT("AtmosphereAutoTuneCandidate"),
+		[Precompute, Settings, AtmosphereSettings, Reference]() {
+			FAutoTuneCandidate Candidate;
+			Candidate.Settings = Settings;
+
+			const FAtmospherePrecomputedTextureData& TextureData = Precompute.GetResult().TextureData;
+			if (!TextureData.Succeeded)
+			{
+				Candidate.Failed = true;
+				return Candidate;
+			}
+
+			const FAtmosphereQuery Query(TextureData, Settings, AtmosphereSettings);
+			Candidate.TransmittanceError = ComputeError(
+				Reference->TransmittanceUVs, Reference->TransmittanceValues, Reference->TransmittancePeak,
+				[&Query](const FVector2f& UV) { return Query.SampleTransmittanceTexture(UV); });
+			Candidate.InScatteredLightError = ComputeError(
+				Reference->InScatteredLightUVWs, Reference->InScatteredLightValues, Reference->InScatteredLightPeak,
+				[&Query](const FVector3f& UVW) { return Query.SampleInScatteredLightTexture(UVW); });
+			return Candidate;
+		},
+		Precompute);
+}
+
+/**
+ * The state of a tuning run, shared by the tasks of all its rounds.
+ */
+struct FAutoTuneState
+{
+	FAtmosphereSettings AtmosphereSettings;
+	FAtmosphereAutoTuneTarget Target;
+	TSharedPtr<const FAutoTuneReference, ESPMode::ThreadSafe> Reference;
+	FAutoTuneCandidate Current;
+
+	/**
+	 * The index of the current reduction factor, see TuneRound.
+	 */
+	int32 FactorIndex = 0;
+
+	TPromise<FAtmosphereAutoTuneResult> Promise;
+
+	bool IsOverBudget(const FPrecomputedTextureSettings& Settings) const
+	{
+		return Target.MemoryBudget > 0
+			&& UAtmosphereResidencySubsystem::EstimateBytes(Settings) > uint64(Target.MemoryBudget);
+	}
+};
+
+using FAutoTuneStateRef = TSharedRef<FAutoTuneState, ESPMode::ThreadSafe>;
+
+/**
+ * Halve values as long as possible, then refine with smaller reductions.
+ */
+static constexpr float ReductionFactors[] = { 0.5f, 0.75f };
+
+/**
+ * Precomputes and evaluates candidates in batches within the limits of FAtmospherePrecomputeScheduler,
+ * and calls OnEvaluated with all of them on a worker thread.
+ * Every batch is evaluated by a task that only runs once the batch has been precomputed, and launches the next batch,
+ * so no thread waits for the GPU.
+ * Candidates are dispatched directly, since the scheduler calls back on the game thread, which may be waiting for the tuner.
+ */
+static void EvaluateCandidates(
+	const TSharedRef<const TArray<FPrecomputedTextureSettings>, ESPMode::ThreadSafe>& Settings,
+	int32 NextIndex,
+	TArray<FAutoTuneCandidate>&& Candidates,
+	const FAutoTuneStateRef& State,
+	TFunction<void(TArray<FAutoTuneCandidate>&&)>&& OnEvaluated)
+{
+	if (NextIndex >= Settings->Num())
+	{
+		OnEvaluated(MoveTemp(Candidates));
+		return;
+	}
+
+	const FAtmospherePrecomputeScheduler& Scheduler = FAtmospherePrecomputeScheduler::Get();
+	const TSharedRef<const FAutoTuneReference, ESPMode::ThreadSafe> Reference = State->Reference.ToSharedRef();
+
+	// always evaluate at least one candidate, even if it exceeds the memory limit on its own
+	TArray<UE::Tasks::TTask<FAutoTuneCandidate>> Batch;
+	uint64 BatchBytes = 0;
+	while (NextIndex < Settings->Num() && Batch.Num() < Scheduler.GetMaxConcurrentJobs())
+	{
+		const uint64 NumBytes = FAtmospherePrecomputeScheduler::EstimateBytesInFlight((*Settings)[NextIndex], false);
+		if (!Batch.IsEmpty() && BatchBytes + NumBytes > Scheduler.GetMaxBytesInFlight())
+		{
+			break;
+		}
+		BatchBytes += NumBytes;
+		Batch.Add(EvaluateCandidate((*Settings)[NextIndex++], State->AtmosphereSettings, Reference));
+	}
+
+	UE::Tasks::Launch(
+		TEXT("AtmosphereAutoTuneBatch"),
+		[Settings, NextIndex, Candidates = MoveTemp(Candidates), State, OnEvaluated = MoveTemp(OnEvaluated), Batch]() mutable {
+			// the batch's tasks are prerequisites, so their results are available without waiting
+			for (const auto& Task : Batch)
+			{
+				Candidates.Add(Task.GetResult());
+			}
+			EvaluateCandidates(Settings, NextIndex, MoveTemp(Candidates), State, MoveTemp(OnEvaluated));
+		},
+		Batch);
+}
+
+static void FinishTuning(const FAutoTuneStateRef& State)
+{
+	const FAutoTuneCandidate& Current = State->Current;
+
+	FAtmosphereAutoTuneResult Result;
+	Result.TextureSettings = Current.Settings;
+	Result.TransmittanceError = Current.TransmittanceError;
+	Result.InScatteredLightError = Current.InScatteredLightError;
+	Result.NumBytes = UAtmosphereResidencySubsystem::EstimateBytes(Current.Settings);
+	Result.MeetsTarget = State->Reference.IsValid() && Current.GetError() <= State->Target.MaxError && !State->IsOverBudget(Current.Settings);
+	State->Promise.SetValue(Result);
+}
+
+/**
+ * Evaluates one candidate per value reduced by the current factor, and continues with the best one in the next round.
+ * Once no candidate meets the target, continues with the next factor, or finishes after the last one.
+ */
+static void TuneRound(const FAutoTuneStateRef& State)
+{
+	const FAtmosphereAutoTuneTarget& Target = State->Target;
+	const FPrecomputedTextureSettings& CurrentSettings = State->Current.Settings;
+	const float Factor = ReductionFactors[State->FactorIndex];
+	const bool OverBudget = State->IsOverBudget(CurrentSettings);
+
+	const auto CandidateSettings = MakeShared<TArray<FPrecomputedTextureSettings>, ESPMode::ThreadSafe>();
+	for (uint8 i = 0; i < uint8(EAutoTuneValue::Num); i++)
+	{
+		const EAutoTuneValue Value = EAutoTuneValue(i);
+		if ((CurrentSettings.OuterShellOnly && Value == EAutoTuneValue::InScatteredLightHeight)
+			|| (OverBudget && IsSampleSteps(Value)))
+		{
+			// doesn't affect the result, or doesn't help fitting the budget
+			continue;
+		}
+
+		FPrecomputedTextureSettings Settings = CurrentSettings;
+		int& Reduced = GetValue(Settings, Value);
+		const int MinValue = IsSampleSteps(Value) ? Target.MinSampleSteps : Target.MinTextureSize;
+		const int NewValue = FMath::Max(MinValue, FMath::FloorToInt(Reduced * Factor));
+		if (NewValue < Reduced)
+		{
+			Reduced = NewValue;
+			CandidateSettings->Add(Settings);
+		}
+	}
+
+	EvaluateCandidates(CandidateSettings, 0, {}, State, [State, OverBudget](TArray<FAutoTuneCandidate>&& Candidates) {
+		// continue with the most accurate candidate, or any candidate while the budget is exceeded
+		const FAutoTuneCandidate* Best = nullptr;
+		for (const FAutoTuneCandidate& Result : Candidates)
+		{
+			if (!Result.Failed && (OverBudget || Result.GetError() <= State->Target.MaxError) && (!Best || Result.GetError() < Best->GetError()))
+			{
+				Best = &Result;
+			}
+		}
+
+		if (Best)
+		{
+			State->Current = *Best;
+			TuneRound(State);
+		}
+		else if (++State->FactorIndex < int32(UE_ARRAY_COUNT(ReductionFactors)))
+		{
+			TuneRound(State);
+		}
+		else
+		{
+			FinishTuning(State);
+		}
+	});
+}
+
+TFuture<FAtmosphereAutoTuneResult> FAtmosphereAutoTuner::AutoTune(
+	const FAtmosphereSettings& AtmosphereSettings,
+	const FAtmosphereAutoTuneTarget& Target)
+{
+	const FAutoTuneStateRef State = MakeShared<FAutoTuneState, ESPMode::ThreadSafe>();
+	State->AtmosphereSettings = AtmosphereSettings;
+	State->Target = Target;
+	State->Current.Settings = Target.ReferenceSettings;
+	State->Current.Settings.InScatteredLightTextureDimensions = State->Current.Settings.GetInScatteredLightTextureSize();
+	State->Current.Settings.ComputeStatistics = false;
+	State->Current.Settings.DebugReadbackSlices.Empty();
+	TFuture<FAtmosphereAutoTuneResult> Future = State->Promise.GetFuture();
+
+	const auto ReferenceTask = FAtmospherePrecomputeShaderDispatcher::LaunchTask(
+		State->Current.Settings, CreatePrecomputeContext(State->Current.Settings, AtmosphereSettings), false);
+
+	UE::Tasks::Launch(
+		TEXT("AtmosphereAutoTune"),
+		[State, ReferenceTask]() {
+			const FAtmospherePrecomputedTextureData& TextureData = ReferenceTask.GetResult().TextureData;
+			if (!TextureData.Succeeded)
+			{
+				// nothing to compare against, so return the reference settings without meeting the target
+				FinishTuning(State);
+				return;
+			}
+
+			State->Reference = MakeShared<const FAutoTuneReference, ESPMode::ThreadSafe>(CreateReference(TextureData));
+			TuneRound(State);
+		},
+		ReferenceTask);
+
+	return Future;
+}
@@ -0,0 +1,73 @@
+#include "AtmosphereComponent.h"
+
+#include "AtmospherePrecompute.h"
+#include "Engine/Texture2D.h"
+#include "GameFramework/Actor.h"
+#include "SweetAtmosphereShaders/Public/Rendering/AtmosphereSceneViewExtension.h"
+
+UAtmosphereComponent::UAtmosphereComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+	bTickInEditor = true;
+}
+
+void UAtmosphereComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	// creating the extension registers it with the engine
+	FAtmosphereSceneViewExtension::Get();
+}
+
+void UAtmosphereComponent::OnUnregister()
+{
+	FAtmosphereSceneViewExtension::Get()->RemoveAtmosphere(GetUniqueID());
+
+	Super::OnUnregister();
+}
+
+void UAtmosphereComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	UTexture* SourceTexture = PrecomputedTextures.GetInScatteredLightTexture();
+	if (!PrecomputedTextures.TransmittanceTexture || !SourceTexture)
+	{
+		FAtmosphereSceneViewExtension::Get()->RemoveAtmosphere(GetUniqueID());
+		return;
+	}
+
+	if (RotatedFromTexture != SourceTexture)
+	{
+		// the precomputed textures have been replaced
+		RotatedInScatteredLightTexture = nullptr;
+		RotatedFromTexture = nullptr;
+	}
+
+	float HueShift;
+	UTexture* InScatteredLightTexture = UAtmosphereMaterialHelper::ResolveHueShift(
+		RotatedInScatteredLightTexture ? RotatedInScatteredLightTexture.Get() : SourceTexture, AtmosphereSettings.HueShift, HueShift);
+	if (InScatteredLightTexture != SourceTexture)
+	{
+		RotatedInScatteredLightTexture = InScatteredLightTexture;
+		RotatedFromTexture = SourceTexture;
+	}
+
+	FAtmosphereRenderParameters Parameters;
+	Parameters.PlanetOrigin = GetComponentLocation();
+	Parameters.PlanetRadius = PlanetRadius;
+	Parameters.SunLightDir = FVector3f(Sun ? Sun->GetActorForwardVector() : SunLightDirection.GetSafeNormal());
+	Parameters.AtmosphereScale = AtmosphereSettings.AtmosphereScale;
+	Parameters.SunIntensity = AtmosphereSettings.SunIntensity;
+	Parameters.HueShift = HueShift;
+
+	// resolved on the render thread, so textures still being streamed in are picked up
+	Parameters.TransmittanceTexture = PrecomputedTextures.TransmittanceTexture->TextureReference.TextureReferenceRHI;
+	Parameters.InScatteredLightTexture = InScatteredLightTexture->TextureReference.TextureReferenceRHI;
+	Parameters.OuterShellOnly = PrecomputedTextures.OuterShellInScatteredLightTexture != nullptr;
+	Parameters.RenderAtReducedResolution = ShouldRenderAtReducedResolution();
+
+	FAtmosphereSceneViewExtension::Get()->SetAtmosphere(GetUniqueID(), Parameters);
+}
@@ -0,0 +1,45 @@
+#include "AtmosphereDefinition.h"
+
+#include "Engine/VolumeTexture.h"
+
+bool UAtmosphereDefinition::HasValidBakedTextures() const
+{
+	return BakedTransmittanceTexture && BakedInScatteredLightTexture
+		&& BakedSettingsHash == GetSettingsHash();
+}
+
+FAtmospherePrecomputedTextures UAtmosphereDefinition::GetBakedTextures() const
+{
+	FAtmospherePrecomputedTextures Textures;
+	Textures.TransmittanceTexture = BakedTransmittanceTexture;
+	Textures.InScatteredLightTexture = Cast<UVolumeTexture>(BakedInScatteredLightTexture);
+	Textures.OuterShellInScatteredLightTexture = Cast<UTexture2D>(BakedInScatteredLightTexture);
+	return Textures;
+}
+
+uint32 UAtmosphereDefinition::GetSettingsHash() const
+{
+	// SunIntensity and HueShift are applied by the material and don't affect baked textures
+	uint32 Hash = GetTypeHash(AtmosphereSettings.AtmosphereScale);
+	for (const auto& Profile : AtmosphereSettings.ParticleProfiles)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(Profile.PhaseFunction));
+		Hash = HashCombine(Hash, GetTypeHash(Profile.ScatteringCoefficients));
+		Hash = HashCombine(Hash, GetTypeHash(Profile.ExponentFactor));
+		Hash = HashCombine(Hash, GetTypeHash(Profile.LinearFadeInSize));
+		Hash = HashCombine(Hash, GetTypeHash(Profile.LinearFadeOutSize));
+	}
+
+	Hash = HashCombine(Hash, GetTypeHash(TextureSettings.TransmittanceTextureWidth));
+	Hash = HashCombine(Hash, GetTypeHash(TextureSettings.TransmittanceTextureHeight));
+	Hash = HashCombine(Hash, GetTypeHash(TextureSettings.GetInScatteredLightTextureSize()));
+	Hash = HashCombine(Hash, GetTypeHash(TextureSettings.TransmittanceSampleSteps));
+	Hash = HashCombine(Hash, GetTypeHash(TextureSettings.InScatteredLightSampleSteps));
+	Hash = HashCombine(Hash, GetTypeHash(TextureSettings.ScatteringLUTSize));
+	Hash = HashCombine(Hash, GetTypeHash(TextureSettings.BuildTransmittanceFromOpticalDepth));
+	Hash = HashCombine(Hash, GetTypeHash(TextureSettings.OuterShellOnly));
+	Hash = HashCombine(Hash, GetTypeHash(TextureSettings.AdaptiveRefinement));
+	Hash = HashCombine(Hash, GetTypeHash(TextureSettings.RefinementThreshold));
+
+	return Hash;
+}
@@ -1,7 +1,12 @@
 #include "AtmospherePrecompute.h"
 
 #include "Interfaces/IPluginManager.h"
+#include "SweetAtmosphereShaders/Public/Precompute/PrecomputeScalability.h"
+#include "SweetAtmosphereShaders/Public/Rendering/AtmosphereHueRotation.h"
+#include "Async/Async.h"
 #include "Engine/VolumeTexture.h"
+#include "Tasks/Task.h"
+#include "UObject/StrongObjectPtr.h"
 
 #define PARTICLE_PROFILE_PARAMETER_NAME(ProfileIndex, Name) \
 	ParticleProfile_##ProfileIndex##_##Name
@@ -20,10 +25,12 @@
 	}
 
 FPrecomputeContext CreatePrecomputeContext(
+	const FPrecomputedTextureSettings& TextureSettings,
 	const FAtmosphereSettings& AtmosphereSettings)
 {
 	FPrecomputeContext Ctx;
 	Ctx.AtmosphereScale = AtmosphereSettings.AtmosphereScale;
+	Ctx.HueShift = TextureSettings.BakeHueShift ? AtmosphereSettings.HueShift : 0;
 
 	check(AtmosphereSettings.ParticleProfiles.Num() <= 5);
 	Ctx.NumParticleProfiles = AtmosphereSettings.ParticleProfiles.Num();
@@ -75,43 +82,195 @@ inline UVolumeTexture* CreateTexture3D(const TArray<uint8>& Data, int Width, int
 	return Texture;
 }
 
-#define CREATE_TEXTURES_FROM_DATA()                                                               \
-	FAtmospherePrecomputedTextures Textures;                                                      \
-	Textures.TransmittanceTexture = TextureData.TransmittanceTextureData.CreateTexture2D();       \
-	Textures.InScatteredLightTexture = TextureData.InScatteredLightTextureData.CreateTexture3D(); \
-	FAtmospherePrecomputeDebugTextures DebugTextures;                                             \
-	for (const auto& [Name, Data] : DebugTextureData.DebugTextureData)                            \
-	{                                                                                             \
-		DebugTextures.DebugTextures.Add(Name, Data.CreateTexture());                              \
+/**
+ * Creates textures from precomputed texture data without stalling the game thread.
+ * The textures are allocated on the game thread and filled on a worker thread.
+ * Their RHI textures are created from the filled mip data on the render thread, see FTextureData::UnlockTexture.
+ * Texture data is released as soon as it has been copied into a texture,
+ * so no more than one extra copy of each texture is held at a time.
+ *
+ * @param TextureData The precomputed texture data.
+ * @param DebugTextureData The debug texture data.
+ * @param TextureSettings The texture settings the data was precomputed with.
+ * @param Ctx The context the data was precomputed with.
+ * @param Callback Called on the game thread once all textures have been created,
+ *                 or right away with empty textures if precomputation failed.
+ */
+static void CreateTexturesAsync(
+	FAtmospherePrecomputedTextureData TextureData,
+	FAtmospherePrecomputedDebugTextureData DebugTextureData,
+	const FPrecomputedTextureSettings& TextureSettings,
+	const FPrecomputeContext& Ctx,
+	TFunction<void(FAtmospherePrecomputedTextures, FAtmospherePrecomputeDebugTextures)> Callback)
+{
+	check(IsInGameThread());
+
+	if (!TextureData.Succeeded)
+	{
+		// the dispatcher has logged the reason
+		Callback(FAtmospherePrecomputedTextures(), FAtmospherePrecomputeDebugTextures());
+		return;
 	}
 
-void UAtmospherePrecomputeAction::PrecomputeAtmosphericScattering(
+	struct FPendingTexture
+	{
+		FString Name;
+		FTextureData Data;
+
+		/**
+		 * Keeps the texture from being garbage collected until it is handed to the callback.
+		 * Only created and destroyed on the game thread.
+		 */
+		TStrongObjectPtr<UTexture> Texture;
+
+		void* MipData;
+
+		/**
+		 * Whether the PF_FloatRGBA data is converted to a PF_FloatR11G11B10 texture.
+		 */
+		bool Compact;
+	};
+
+	// the precomputed textures come first, followed by all debug textures
+	TArray<FPendingTexture> Pending;
+	auto AddPending = [&Pending](const FString& Name, FTextureData&& Data, const bool Compact) {
+		FPendingTexture& Texture = Pending.AddDefaulted_GetRef();
+		Texture.Name = Name;
+		Texture.Data = MoveTemp(Data);
+		Texture.Compact = Compact && Texture.Data.PixelFormat == PF_FloatRGBA;
+		Texture.Texture.Reset(Texture.Compact
+			? FTextureData(Texture.Data.Size, PF_FloatR11G11B10, {}).CreateLockedTexture(Texture.MipData)
+			: Texture.Data.CreateLockedTexture(Texture.MipData));
+	};
+	AddPending(TEXT("Transmittance"), MoveTemp(TextureData.TransmittanceTextureData), TextureSettings.CompactTextureFormat);
+	AddPending(TEXT("In-Scattered Light"), MoveTemp(TextureData.InScatteredLightTextureData), TextureSettings.UseCompactInScatteredLightFormat());
+	for (auto& [Name, Data] : DebugTextureData.DebugTextureData)
+	{
+		// debug textures are read back as PF_FloatRGBA, see UDebugTextureHelper
+		AddPending(Name, MoveTemp(Data), false);
+	}
+
+	UE::Tasks::Launch(
+		TEXT("CreateAtmosphereTextures"),
+		[Pending = MoveTemp(Pending), Statistics = MoveTemp(DebugTextureData.Statistics), TextureSettings, Ctx, Callback = MoveTemp(Callback)]() mutable {
+			for (auto& Texture : Pending)
+			{
+				if (Texture.Compact)
+				{
+					// precomputed textures have no alpha
+					const auto* Source = reinterpret_cast<const FFloat16Color*>(Texture.Data.Data.GetData());
+					auto* Target = static_cast<FFloat3Packed*>(Texture.MipData);
+					const int64 NumTexels = Texture.Data.Data.Num() / sizeof(FFloat16Color);
+					for (int64 i = 0; i < NumTexels; i++)
+					{
+						Target[i] = FFloat3Packed(Source[i].GetFloats());
+					}
+				}
+				else
+				{
+					FMemory::Memcpy(Texture.MipData, Texture.Data.Data.GetData(), Texture.Data.Data.Num());
+				}
+				Texture.Data.Data.Empty();
+			}
+
+			AsyncTask(ENamedThreads::GameThread, [Pending = MoveTemp(Pending), Statistics = MoveTemp(Statistics), TextureSettings, Ctx, Callback = MoveTemp(Callback)]() {
+				for (const auto& Texture : Pending)
+				{
+					FTextureData::UnlockTexture(Texture.Texture.Get());
+				}
+
+				FAtmospherePrecomputedTextures Textures;
+				Textures.TransmittanceTexture = CastChecked<UTexture2D>(Pending[0].Texture.Get());
+				if (auto* VolumeTexture = Cast<UVolumeTexture>(Pending[1].Texture.Get()))
+				{
+					Textures.InScatteredLightTexture = VolumeTexture;
+				}
+				else
+				{
+					Textures.OuterShellInScatteredLightTexture = CastChecked<UTexture2D>(Pending[1].Texture.Get());
+				}
+				if (TextureSettings.BakeHueShift)
+				{
+					// remember how the texture was precomputed, so it can be precomputed again at another hue shift
+					UTexture* InScatteredLightTexture = Textures.GetInScatteredLightTexture();
+					auto* BakeData = NewObject<UAtmosphereHueShiftBakeData>(InScatteredLightTexture);
+					BakeData->TextureSettings = TextureSettings;
+					BakeData->Ctx = Ctx;
+					InScatteredLightTexture->AddAssetUserData(BakeData);
+				}
+
+				FAtmospherePrecomputeDebugTextures DebugTextures;
+				for (int i = 2; i < Pending.Num(); i++)
+				{
+					DebugTextures.DebugTextures.Add(Pending[i].Name, Pending[i].Texture.Get());
+				}
+				DebugTextures.Statistics = Statistics;
+
+				Callback(Textures, DebugTextures);
+			});
+		});
+}
+
+FAtmospherePrecomputeJobHandle UAtmospherePrecomputeAction::PrecomputeAtmosphericScattering(
 	FPrecomputedTextureSettings TextureSettings,
 	FAtmosphereSettings AtmosphereSettings,
 	bool GenerateDebugTextures,
-	TFunction<void(FAtmospherePrecomputedTextures, FAtmospherePrecomputeDebugTextures)> Callback)
+	TFunction<void(FAtmospherePrecomputedTextures, FAtmospherePrecomputeDebugTextures)> Callback,
+	const UObject* Owner,
+	const float Priority)
 {
-	const auto Ctx = CreatePrecomputeContext(AtmosphereSettings);
-	FAtmospherePrecomputeShaderDispatcher::Dispatch(TextureSettings, Ctx, GenerateDebugTextures, [Callback, TextureSettings](FAtmospherePrecomputedTextureData TextureData, FAtmospherePrecomputedDebugTextureData DebugTextureData) {
-		CREATE_TEXTURES_FROM_DATA()
-		Callback(Textures, DebugTextures);
+	TextureSettings = FAtmosphereScalability::Apply(TextureSettings);
+	const auto Ctx = CreatePrecomputeContext(TextureSettings, AtmosphereSettings);
+	return FAtmospherePrecomputeScheduler::Get().Enqueue(Owner, TextureSettings, Ctx, GenerateDebugTextures, Priority, [Callback, TextureSettings, Ctx](FAtmospherePrecomputedTextureData TextureData, FAtmospherePrecomputedDebugTextureData DebugTextureData) {
+		CreateTexturesAsync(MoveTemp(TextureData), MoveTemp(DebugTextureData), TextureSettings, Ctx, Callback);
 	});
 }
 
+/**
+ * The action of every owner whose precomputation is still pending, see UAtmospherePrecomputeAction::PrecomputeAtmosphericScattering.
+ * Only accessed from the game thread.
+ */
+static TMap<FObjectKey, TWeakObjectPtr<UAtmospherePrecomputeAction>> PendingActionsByOwner;
+
 UAtmospherePrecomputeAction* UAtmospherePrecomputeAction::PrecomputeAtmosphericScattering(
 	const UObject* WorldContextObject,
 	const FPrecomputedTextureSettings& TextureSettings,
 	const FAtmosphereSettings& AtmosphereSettings,
-	const bool GenerateDebugTextures)
+	const bool GenerateDebugTextures,
+	const UObject* Owner,
+	const float Priority)
 {
-	const auto Ctx = CreatePrecomputeContext(AtmosphereSettings);
+	const FPrecomputedTextureSettings ScaledSettings = FAtmosphereScalability::Apply(TextureSettings);
+	const auto Ctx = CreatePrecomputeContext(ScaledSettings, AtmosphereSettings);
 
 	auto* Action = NewObject<UAtmospherePrecomputeAction>();
-	Action->Init(TextureSettings, Ctx, GenerateDebugTextures);
+	Action->Init(ScaledSettings, Ctx, GenerateDebugTextures);
+	Action->Owner = FObjectKey(Owner);
+	Action->Priority = Priority;
 	Action->RegisterWithGameInstance(WorldContextObject);
 	return Action;
 }
 
+UAtmospherePrecomputeAction* UAtmospherePrecomputeAction::LoadOrPrecomputeAtmosphericScattering(
+	const UObject* WorldContextObject,
+	const UAtmosphereDefinition* Definition,
+	const bool GenerateDebugTextures,
+	const UObject* Owner,
+	const float Priority)
+{
+	check(Definition);
+
+	auto* Action = PrecomputeAtmosphericScattering(WorldContextObject,
+		Definition->TextureSettings, Definition->AtmosphereSettings, GenerateDebugTextures, Owner, Priority);
+	// baked assets never contain the hue shift, see UBakeAtmosphereTexturesCommandlet,
+	// so definitions that bake it into the texture are always precomputed
+	if (!GenerateDebugTextures && !Definition->TextureSettings.BakeHueShift && Definition->HasValidBakedTextures())
+	{
+		Action->BakedTextures = Definition->GetBakedTextures();
+	}
+	return Action;
+}
+
 void UAtmospherePrecomputeAction::Init(
 	const FPrecomputedTextureSettings& _TextureSettings,
 	const FPrecomputeContext& _AtmosphereGenerationSettings,
@@ -124,18 +283,84 @@ void UAtmospherePrecomputeAction::Init(
 
 void UAtmospherePrecomputeAction::Activate()
 {
+	if (BakedTextures.TransmittanceTexture && BakedTextures.GetInScatteredLightTexture())
+	{
+		// textures have been baked ahead of time, no need to precompute them
+		OnComplete.Broadcast(BakedTextures, FAtmospherePrecomputeDebugTextures());
+		SetReadyToDestroy();
+		return;
+	}
+
+	if (Owner != FObjectKey())
+	{
+		// a newer request makes the pending one of the same owner obsolete, even if it is already in flight
+		if (const auto* Pending = PendingActionsByOwner.Find(Owner); Pending && Pending->IsValid())
+		{
+			(*Pending)->Cancel();
+		}
+
+		// forget about owners whose action has been garbage collected
+		for (auto It = PendingActionsByOwner.CreateIterator(); It; ++It)
+		{
+			if (!It.Value().IsValid())
+			{
+				It.RemoveCurrent();
+			}
+		}
+		PendingActionsByOwner.Add(Owner, this);
+	}
+
 	// Dispatch the compute shader and call the event when it completes
-	FAtmospherePrecomputeShaderDispatcher::Dispatch(
+	TWeakObjectPtr<UAtmospherePrecomputeAction> WeakThis(this);
+	JobHandle = FAtmospherePrecomputeScheduler::Get().Enqueue(
+		Owner,
 		TextureSettings,
 		AtmosphereGenerationSettings,
 		GenerateDebugTextures,
-		[this](FAtmospherePrecomputedTextureData TextureData, FAtmospherePrecomputedDebugTextureData DebugTextureData) {
-			CREATE_TEXTURES_FROM_DATA()
-			OnComplete.Broadcast(Textures, DebugTextures);
-			SetReadyToDestroy();
+		Priority,
+		[WeakThis, TextureSettings = TextureSettings, Ctx = AtmosphereGenerationSettings](FAtmospherePrecomputedTextureData TextureData, FAtmospherePrecomputedDebugTextureData DebugTextureData) {
+			CreateTexturesAsync(MoveTemp(TextureData), MoveTemp(DebugTextureData), TextureSettings, Ctx,
+				[WeakThis](const FAtmospherePrecomputedTextures& Textures, const FAtmospherePrecomputeDebugTextures& DebugTextures) {
+					auto* This = WeakThis.Get();
+					if (!This || !This->JobHandle.IsValid())
+					{
+						// canceled while the textures were being created
+						return;
+					}
+
+					This->Finish();
+					if (Textures.TransmittanceTexture)
+					{
+						This->OnComplete.Broadcast(Textures, DebugTextures);
+					}
+					else
+					{
+						This->OnFailed.Broadcast(Textures, DebugTextures);
+					}
+				});
 		});
 }
 
+void UAtmospherePrecomputeAction::Cancel()
+{
+	if (JobHandle.IsValid())
+	{
+		FAtmospherePrecomputeScheduler::Get().Cancel(JobHandle);
+		Finish();
+	}
+}
+
+void UAtmospherePrecomputeAction::Finish()
+{
+	if (const auto* Pending = PendingActionsByOwner.Find(Owner); Pending && Pending->Get() == this)
+	{
+		PendingActionsByOwner.Remove(Owner);
+	}
+
+	JobHandle = FAtmospherePrecomputeJobHandle();
+	SetReadyToDestroy();
+}
+
 UMaterialInstanceDynamic* UAtmosphereMaterialHelper::CreateAtmosphereMaterial(
 	UMaterialInterface* ParentMaterial,
 	const FAtmosphereSettings& AtmosphereSettings,
@@ -143,8 +368,9 @@ UMaterialInstanceDynamic* UAtmosphereMaterialHelper::CreateAtmosphereMaterial(
 {
 	auto* Instance = UMaterialInstanceDynamic::Create(ParentMaterial, nullptr);
 
-	BindAtmosphereSettings(Instance, AtmosphereSettings);
+	// bind textures first so BindAtmosphereSettings can detect a baked hue shift
 	BindPrecomputedTextures(Instance, PrecomputedTextures);
+	BindAtmosphereSettings(Instance, AtmosphereSettings);
 
 	return Instance;
 }
@@ -153,11 +379,59 @@ void UAtmosphereMaterialHelper::BindAtmosphereSettings(UMaterialInstanceDynamic*
 {
 	MaterialInstance->SetScalarParameterValue("AtmosphereScale", Atmosphere.AtmosphereScale);
 	MaterialInstance->SetScalarParameterValue("SunIntensity", Atmosphere.SunIntensity);
-	MaterialInstance->SetScalarParameterValue("HueShift", Atmosphere.HueShift);
+
+	UTexture* InScatteredLightTexture = MaterialInstance->K2_GetTextureParameterValue("InScatteredLightTexture");
+	float HueShift;
+	UTexture* ResolvedTexture = ResolveHueShift(InScatteredLightTexture, Atmosphere.HueShift, HueShift);
+	if (ResolvedTexture != InScatteredLightTexture)
+	{
+		// the hue has been rotated into a texture of this material instance
+		MaterialInstance->SetTextureParameterValue("InScatteredLightTexture", ResolvedTexture);
+	}
+	MaterialInstance->SetScalarParameterValue("HueShift", HueShift);
+}
+
+UTexture* UAtmosphereMaterialHelper::ResolveHueShift(UTexture* InScatteredLightTexture, const float HueShift, float& OutHueShift)
+{
+	check(IsInGameThread());
+
+	auto* BakeData = InScatteredLightTexture ? InScatteredLightTexture->GetAssetUserData<UAtmosphereHueShiftBakeData>() : nullptr;
+	if (!BakeData)
+	{
+		OutHueShift = HueShift;
+		return InScatteredLightTexture;
+	}
+
+	OutHueShift = 0;
+	if (BakeData->Ctx.HueShift == HueShift)
+	{
+		return InScatteredLightTexture;
+	}
+
+	// always rotate the precomputed texture, so repeated rotations don't accumulate rounding errors
+	UTexture* SourceTexture = BakeData->RotatedFrom ? BakeData->RotatedFrom.Get() : InScatteredLightTexture;
+	const float SourceHueShift = SourceTexture->GetAssetUserData<UAtmosphereHueShiftBakeData>()->Ctx.HueShift;
+
+	UTexture* Target = InScatteredLightTexture;
+	if (!BakeData->RotatedFrom)
+	{
+		// the precomputed texture is never modified, so it can be shared by renderers with different hue shifts
+		Target = FAtmosphereHueRotation::CreateTarget(SourceTexture);
+		auto* TargetBakeData = NewObject<UAtmosphereHueShiftBakeData>(Target);
+		TargetBakeData->TextureSettings = BakeData->TextureSettings;
+		TargetBakeData->Ctx = BakeData->Ctx;
+		TargetBakeData->RotatedFrom = SourceTexture;
+		Target->AddAssetUserData(TargetBakeData);
+		BakeData = TargetBakeData;
+	}
+
+	FAtmosphereHueRotation::Rotate(SourceTexture, Target, HueShift - SourceHueShift);
+	BakeData->Ctx.HueShift = HueShift;
+	return Target;
 }
 
 void UAtmosphereMaterialHelper::BindPrecomputedTextures(UMaterialInstanceDynamic* MaterialInstance, const FAtmospherePrecomputedTextures& PrecomputedTextures)
 {
 	MaterialInstance->SetTextureParameterValue("TransmittanceTexture", PrecomputedTextures.TransmittanceTexture);
-	MaterialInstance->SetTextureParameterValue("InScatteredLightTexture", PrecomputedTextures.InScatteredLightTexture);
+	MaterialInstance->SetTextureParameterValue("InScatteredLightTexture", PrecomputedTextures.GetInScatteredLightTexture());
 }
@@ -0,0 +1,213 @@
+#include "AtmosphereProxyComponent.h"
+
+#include "Engine/World.h"
+
+/**
+ * Creates a unit sphere by subdividing an icosahedron.
+ *
+ * @param Subdivisions The amount of times to subdivide every triangle into four.
+ * @param Vertices The vertices on the unit sphere.
+ * @param Triangles The vertex indices of every triangle, in no particular winding order.
+ */
+static void CreateIcosphere(const int Subdivisions, TArray<FVector>& Vertices, TArray<int32>& Triangles)
+{
+	const double t = (1 + FMath::Sqrt(5.0)) / 2;
+	Vertices = {
+		FVector(-1, t, 0), FVector(1, t, 0), FVector(-1, -t, 0), FVector(1, -t, 0),
+		FVector(0, -1, t), FVector(0, 1, t), FVector(0, -1, -t), FVector(0, 1, -t),
+		FVector(t, 0, -1), FVector(t, 0, 1), FVector(-t, 0, -1), FVector(-t, 0, 1)
+	};
+	for (auto& Vertex : Vertices)
+	{
+		Vertex.Normalize();
+	}
+
+	Triangles = {
+		0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+		1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+		3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+		4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1
+	};
+
+	for (int i = 0; i < Subdivisions; i++)
+	{
+		// shared edges must share their midpoint
+		TMap<uint64, int32> Midpoints;
+		auto GetMidpoint = [&Vertices, &Midpoints](const int32 A, const int32 B) {
+			const uint64 Key = (static_cast<uint64>(FMath::Min(A, B)) << 32) | FMath::Max(A, B);
+			if (const int32* Index = Midpoints.Find(Key))
+			{
+				return *Index;
+			}
+			const int32 Index = Vertices.Add(((Vertices[A] + Vertices[B]) / 2).GetSafeNormal());
+			Midpoints.Add(Key, Index);
+			return Index;
+		};
+
+		TArray<int32> Subdivided;
+		Subdivided.Reserve(Triangles.Num() * 4);
+		for (int j = 0; j < Triangles.Num(); j += 3)
+		{
+			const int32 A = Triangles[j], B = Triangles[j + 1], C = Triangles[j + 2];
+			const int32 AB = GetMidpoint(A, B), BC = GetMidpoint(B, C), CA = GetMidpoint(C, A);
+			Subdivided.Append({ A, AB, CA, B, BC, AB, C, CA, BC, AB, BC, CA });
+		}
+		Triangles = MoveTemp(Subdivided);
+	}
+}
+
+UAtmosphereProxyComponent::UAtmosphereProxyComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	bTickInEditor = true;
+
+	// the material shades the atmosphere itself
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	CastShadow = false;
+	bUseAsyncCooking = true;
+}
+
+void UAtmosphereProxyComponent::SetShellSize(const float _PlanetRadius, const float _AtmosphereScale)
+{
+	PlanetRadius = _PlanetRadius;
+	AtmosphereScale = _AtmosphereScale;
+	RebuildMesh();
+}
+
+void UAtmosphereProxyComponent::SetAtmosphereMaterial(UMaterialInterface* Material)
+{
+	AtmosphereMaterial = Material;
+	SetMaterial(0, Material);
+	SetMaterial(1, Material);
+}
+
+void UAtmosphereProxyComponent::OnRegister()
+{
+	Super::OnRegister();
+	RebuildMesh();
+}
+
+#if WITH_EDITOR
+void UAtmosphereProxyComponent::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	RebuildMesh();
+}
+#endif
+
+void UAtmosphereProxyComponent::RebuildMesh()
+{
+	TArray<FVector> UnitVertices;
+	TArray<int32> UnitTriangles;
+	CreateIcosphere(FMath::Clamp(Subdivisions, 0, 5), UnitVertices, UnitTriangles);
+
+	// orient every triangle to face outwards,
+	// and find the face closest to the center to circumscribe the shell.
+	double MinFaceDistance = 1;
+	for (int i = 0; i < UnitTriangles.Num(); i += 3)
+	{
+		const FVector& A = UnitVertices[UnitTriangles[i]];
+		const FVector& B = UnitVertices[UnitTriangles[i + 1]];
+		const FVector& C = UnitVertices[UnitTriangles[i + 2]];
+
+		const FVector Normal = ((B - A) ^ (C - A)).GetSafeNormal();
+		const double FaceDistance = Normal | A;
+		if (FaceDistance < 0)
+		{
+			Swap(UnitTriangles[i + 1], UnitTriangles[i + 2]);
+		}
+		MinFaceDistance = FMath::Min(MinFaceDistance, FMath::Abs(FaceDistance));
+	}
+
+	InnerRadius = PlanetRadius * (1 + AtmosphereScale);
+	OuterRadius = InnerRadius / MinFaceDistance;
+
+	FacePlanes.Reset(UnitTriangles.Num() / 3);
+	for (int i = 0; i < UnitTriangles.Num(); i += 3)
+	{
+		FacePlanes.Add(FPlane(
+			UnitVertices[UnitTriangles[i]] * OuterRadius,
+			UnitVertices[UnitTriangles[i + 1]] * OuterRadius,
+			UnitVertices[UnitTriangles[i + 2]] * OuterRadius));
+	}
+
+	TArray<FVector> Vertices;
+	TArray<FVector> Normals;
+	Vertices.Reserve(UnitVertices.Num());
+	Normals.Reserve(UnitVertices.Num());
+	for (const auto& Vertex : UnitVertices)
+	{
+		Vertices.Add(Vertex * OuterRadius);
+		Normals.Add(Vertex);
+	}
+
+	// section 0 faces outwards, section 1 faces inwards
+	CreateMeshSection(0, Vertices, UnitTriangles, Normals, {}, {}, {}, false);
+
+	TArray<int32> InwardTriangles;
+	InwardTriangles.Reserve(UnitTriangles.Num());
+	for (int i = 0; i < UnitTriangles.Num(); i += 3)
+	{
+		InwardTriangles.Append({ UnitTriangles[i], UnitTriangles[i + 2], UnitTriangles[i + 1] });
+	}
+	for (auto& Normal : Normals)
+	{
+		Normal = -Normal;
+	}
+	CreateMeshSection(1, Vertices, InwardTriangles, Normals, {}, {}, {}, false);
+
+	if (AtmosphereMaterial)
+	{
+		SetMaterial(0, AtmosphereMaterial);
+		SetMaterial(1, AtmosphereMaterial);
+	}
+}
+
+void UAtmosphereProxyComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	const UWorld* World = GetWorld();
+	if (!World || World->ViewLocationsRenderedLastFrame.IsEmpty())
+	{
+		return;
+	}
+
+	// only ever show one section, so no pixel is shaded twice.
+	// the inward facing section covers every pixel of the sphere exactly once from any view, like an inverted cube,
+	// so it is shown as soon as any view is inside the sphere. otherwise, the outward facing section is shown.
+	bool AnyViewInside = false;
+	for (const FVector& ViewLocation : World->ViewLocationsRenderedLastFrame)
+	{
+		AnyViewInside |= IsInside(GetComponentTransform().InverseTransformPosition(ViewLocation));
+	}
+
+	if (IsMeshSectionVisible(0) == AnyViewInside)
+	{
+		SetMeshSectionVisible(0, !AnyViewInside);
+	}
+	if (IsMeshSectionVisible(1) != AnyViewInside)
+	{
+		SetMeshSectionVisible(1, AnyViewInside);
+	}
+}
+
+bool UAtmosphereProxyComponent::IsInside(const FVector& LocalPosition) const
+{
+	const double Distance = LocalPosition.Size();
+	if (Distance <= InnerRadius || Distance >= OuterRadius)
+	{
+		return Distance <= InnerRadius;
+	}
+
+	// between the sphere's faces and vertices, the position may be on either side
+	for (const FPlane& Plane : FacePlanes)
+	{
+		if (Plane.PlaneDot(LocalPosition) > 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,269 @@
+#include "AtmosphereQuery.h"
+
+#include "Async/ParallelFor.h"
+
+/**
+ * The amount of rays looked up by a single worker thread.
+ */
+static constexpr int32 RaysPerBatch = 256;
+
+/**
+ * The amount of rays whose texture coordinates are computed together, one per vector lane.
+ */
+static constexpr int32 RaysPerGroup = 4;
+
+static_assert(RaysPerBatch % RaysPerGroup == 0, "Batches must consist of whole groups");
+
+/**
+ * Converts PF_FloatRGBA texture data into float texels.
+ */
+static TArray<FVector4f> ConvertTexels(const FTextureData& TextureData)
+{
+	check(TextureData.PixelFormat == PF_FloatRGBA);
+
+	const int32 NumTexels = TextureData.Data.Num() / sizeof(FFloat16Color);
+	const auto* Source = reinterpret_cast<const FFloat16Color*>(TextureData.Data.GetData());
+
+	TArray<FVector4f> Texels;
+	Texels.SetNumUninitialized(NumTexels);
+	for (int32 i = 0; i < NumTexels; i++)
+	{
+		Texels[i] = FVector4f(Source[i].R.GetFloat(), Source[i].G.GetFloat(), Source[i].B.GetFloat(), Source[i].A.GetFloat());
+	}
+	return Texels;
+}
+
+/**
+ * Finds the two texels to interpolate between along one texture axis, the same way a linear clamped sampler does:
+ * texel i is centered at uv = (i + 0.5) / Size, and coordinates outside of the outermost texel centers are clamped to them.
+ */
+FORCEINLINE static void GetLinearTexels(const float uv, const int32 Size, int32& OutTexel0, int32& OutTexel1, float& OutAlpha)
+{
+	const float x = FMath::Clamp(uv * Size - 0.5f, 0.f, Size - 1.f);
+	OutTexel0 = FMath::FloorToInt32(x);
+	OutTexel1 = FMath::Min(OutTexel0 + 1, Size - 1);
+	OutAlpha = x - OutTexel0;
+}
+
+FORCEINLINE static VectorRegister4Float LoadTexel(const TArray<FVector4f>& Texels, const int32 Index)
+{
+	return VectorLoad(&Texels.GetData()[Index].X);
+}
+
+FORCEINLINE static VectorRegister4Float Lerp(const VectorRegister4Float A, const VectorRegister4Float B, const float Alpha)
+{
+	return VectorMultiplyAdd(VectorSubtract(B, A), VectorSetFloat1(Alpha), A);
+}
+
+static VectorRegister4Float SampleBilinear(const TArray<FVector4f>& Texels, const FIntVector& Size, const float u, const float v)
+{
+	int32 x0, x1, y0, y1;
+	float ax, ay;
+	GetLinearTexels(u, Size.X, x0, x1, ax);
+	GetLinearTexels(v, Size.Y, y0, y1, ay);
+
+	const VectorRegister4Float Row0 = Lerp(LoadTexel(Texels, y0 * Size.X + x0), LoadTexel(Texels, y0 * Size.X + x1), ax);
+	const VectorRegister4Float Row1 = Lerp(LoadTexel(Texels, y1 * Size.X + x0), LoadTexel(Texels, y1 * Size.X + x1), ax);
+	return Lerp(Row0, Row1, ay);
+}
+
+static VectorRegister4Float SampleTrilinear(const TArray<FVector4f>& Texels, const FIntVector& Size, const float u, const float v, const float w)
+{
+	int32 x0, x1, y0, y1, z0, z1;
+	float ax, ay, az;
+	GetLinearTexels(u, Size.X, x0, x1, ax);
+	GetLinearTexels(v, Size.Y, y0, y1, ay);
+	GetLinearTexels(w, Size.Z, z0, z1, az);
+
+	auto SampleSlice = [&Texels, &Size, x0, x1, y0, y1, ax, ay](const int32 z) {
+		const int32 Slice = z * Size.X * Size.Y;
+		const VectorRegister4Float Row0 = Lerp(LoadTexel(Texels, Slice + y0 * Size.X + x0), LoadTexel(Texels, Slice + y0 * Size.X + x1), ax);
+		const VectorRegister4Float Row1 = Lerp(LoadTexel(Texels, Slice + y1 * Size.X + x0), LoadTexel(Texels, Slice + y1 * Size.X + x1), ax);
+		return Lerp(Row0, Row1, ay);
+	};
+	return Lerp(SampleSlice(z0), SampleSlice(z1), az);
+}
+
+/**
+ * Maps the cosines of four rays to texture coordinates, see GetInScatteredLight in InScatteredLight.ush.
+ */
+FORCEINLINE static VectorRegister4Float EncodeCos(const VectorRegister4Float Cos)
+{
+	const VectorRegister4Float Half = VectorSetFloat1(0.5f);
+	return VectorMin(VectorMax(VectorNegateMultiplyAdd(Cos, Half, Half), VectorZeroFloat()), VectorOneFloat());
+}
+
+/**
+ * The texture coordinates of a group of rays.
+ */
+struct FRayGroupCoords
+{
+	alignas(16) float Height01[RaysPerGroup];
+	alignas(16) float RayDirCoord[RaysPerGroup];
+	alignas(16) float SunDirCoord[RaysPerGroup];
+};
+
+/**
+ * Computes the texture coordinates of a group of rays at once, with one ray per vector lane.
+ * Lanes beyond the last ray repeat it.
+ */
+static void ComputeRayGroupCoords(
+	const FVector& PlanetOrigin,
+	const double PlanetRadius,
+	const float AtmosphereScale,
+	const TConstArrayView<FAtmosphereQueryRay> Rays,
+	const int32 First,
+	FRayGroupCoords& OutCoords)
+{
+	// transpose the rays, so that every register holds one component of all rays.
+	// offsets are subtracted in double precision, so that they stay exact far away from the world origin.
+	alignas(16) float Offset[3][RaysPerGroup];
+	alignas(16) float Dir[3][RaysPerGroup];
+	alignas(16) float SunDir[3][RaysPerGroup];
+	for (int32 Lane = 0; Lane < RaysPerGroup; Lane++)
+	{
+		const FAtmosphereQueryRay& Ray = Rays[FMath::Min(First + Lane, Rays.Num() - 1)];
+		const FVector3f RayOffset(Ray.Position - PlanetOrigin);
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			Offset[Axis][Lane] = RayOffset[Axis];
+			Dir[Axis][Lane] = Ray.Direction[Axis];
+			SunDir[Axis][Lane] = Ray.SunLightDir[Axis];
+		}
+	}
+
+	const VectorRegister4Float X = VectorLoadAligned(Offset[0]);
+	const VectorRegister4Float Y = VectorLoadAligned(Offset[1]);
+	const VectorRegister4Float Z = VectorLoadAligned(Offset[2]);
+	const VectorRegister4Float Distance = VectorSqrt(VectorMultiplyAdd(X, X, VectorMultiplyAdd(Y, Y, VectorMultiply(Z, Z))));
+
+	// rays starting at the planet origin point up
+	const VectorRegister4Float HasDistance = VectorCompareGT(Distance, VectorZeroFloat());
+	const VectorRegister4Float NormalX = VectorSelect(HasDistance, VectorDivide(X, Distance), VectorZeroFloat());
+	const VectorRegister4Float NormalY = VectorSelect(HasDistance, VectorDivide(Y, Distance), VectorZeroFloat());
+	const VectorRegister4Float NormalZ = VectorSelect(HasDistance, VectorDivide(Z, Distance), VectorOneFloat());
+
+	auto DotNormal = [NormalX, NormalY, NormalZ](const float (&Vector)[3][RaysPerGroup]) {
+		return VectorMultiplyAdd(NormalX, VectorLoadAligned(Vector[0]),
+			VectorMultiplyAdd(NormalY, VectorLoadAligned(Vector[1]),
+				VectorMultiply(NormalZ, VectorLoadAligned(Vector[2]))));
+	};
+
+	// see GetTransmittance in Transmittance.ush and GetInScatteredLight in InScatteredLight.ush
+	const float HeightScale = 1 / (PlanetRadius * AtmosphereScale);
+	VectorStoreAligned(VectorMultiplyAdd(Distance, VectorSetFloat1(HeightScale), VectorSetFloat1(-1 / AtmosphereScale)), OutCoords.Height01);
+	VectorStoreAligned(EncodeCos(DotNormal(Dir)), OutCoords.RayDirCoord);
+	VectorStoreAligned(EncodeCos(DotNormal(SunDir)), OutCoords.SunDirCoord);
+}
+
+/**
+ * Runs a lookup for every group of rays, in batches across worker threads.
+ * The lookup receives the index of the group's first ray and the amount of rays in the group.
+ */
+template <typename LookupType>
+static void ForEachRayGroup(const int32 NumRays, const LookupType& Lookup)
+{
+	const int32 NumBatches = FMath::DivideAndRoundUp(NumRays, RaysPerBatch);
+	ParallelFor(NumBatches, [NumRays, &Lookup](const int32 BatchIndex) {
+		const int32 End = FMath::Min(NumRays, (BatchIndex + 1) * RaysPerBatch);
+		for (int32 First = BatchIndex * RaysPerBatch; First < End; First += RaysPerGroup)
+		{
+			Lookup(First, FMath::Min(RaysPerGroup, End - First));
+		}
+	}, NumBatches > 1 ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+}
+
+FAtmosphereQuery::FAtmosphereQuery(
+	const FAtmospherePrecomputedTextureData& TextureData,
+	const FPrecomputedTextureSettings& TextureSettings,
+	const FAtmosphereSettings& AtmosphereSettings)
+	: TransmittanceSize(TextureData.TransmittanceTextureData.Size),
+	  InScatteredLightSize(TextureData.InScatteredLightTextureData.Size),
+	  TransmittanceTexels(ConvertTexels(TextureData.TransmittanceTextureData)),
+	  InScatteredLightTexels(ConvertTexels(TextureData.InScatteredLightTextureData)),
+	  AtmosphereScale(AtmosphereSettings.AtmosphereScale),
+	  SunIntensity(AtmosphereSettings.SunIntensity),
+	  HueShift(TextureSettings.BakeHueShift ? 0 : AtmosphereSettings.HueShift)
+{
+	check(!TextureData.TransmittanceTextureData.IsVolumeTexture());
+}
+
+void FAtmosphereQuery::GetTransmittance(
+	const FVector& PlanetOrigin,
+	const double PlanetRadius,
+	const TConstArrayView<FAtmosphereQueryRay> Rays,
+	const TArrayView<FLinearColor> OutTransmittance) const
+{
+	check(Rays.Num() == OutTransmittance.Num());
+
+	ForEachRayGroup(Rays.Num(), [this, &PlanetOrigin, PlanetRadius, Rays, OutTransmittance](const int32 First, const int32 NumRays) {
+		FRayGroupCoords Coords;
+		ComputeRayGroupCoords(PlanetOrigin, PlanetRadius, AtmosphereScale, Rays, First, Coords);
+
+		for (int32 Lane = 0; Lane < NumRays; Lane++)
+		{
+			VectorStore(SampleBilinear(TransmittanceTexels, TransmittanceSize, Coords.Height01[Lane], Coords.RayDirCoord[Lane]),
+				&OutTransmittance[First + Lane].R);
+		}
+	});
+}
+
+void FAtmosphereQuery::GetInScatteredLight(
+	const FVector& PlanetOrigin,
+	const double PlanetRadius,
+	const TConstArrayView<FAtmosphereQueryRay> Rays,
+	const TArrayView<FLinearColor> OutInScatteredLight) const
+{
+	check(Rays.Num() == OutInScatteredLight.Num());
+
+	// see ShiftHue in HueShift.ush
+	const FVector3f K(0.57735f);
+	const float CosAngle = FMath::Cos(HueShift);
+	const float SinAngle = FMath::Sin(HueShift);
+
+	ForEachRayGroup(Rays.Num(), [this, &PlanetOrigin, PlanetRadius, Rays, OutInScatteredLight, K, CosAngle, SinAngle](const int32 First, const int32 NumRays) {
+		FRayGroupCoords Coords;
+		ComputeRayGroupCoords(PlanetOrigin, PlanetRadius, AtmosphereScale, Rays, First, Coords);
+
+		for (int32 Lane = 0; Lane < NumRays; Lane++)
+		{
+			// see GetInScatteredLight and GetOuterShellInScatteredLight in InScatteredLight.ush
+			VectorRegister4Float Sample;
+			if (InScatteredLightSize.Z > 0)
+			{
+				Sample = SampleTrilinear(InScatteredLightTexels, InScatteredLightSize, Coords.Height01[Lane], Coords.RayDirCoord[Lane], Coords.SunDirCoord[Lane]);
+			}
+			else
+			{
+				Sample = SampleBilinear(InScatteredLightTexels, InScatteredLightSize, Coords.RayDirCoord[Lane], Coords.SunDirCoord[Lane]);
+			}
+			Sample = VectorMultiply(Sample, VectorSetFloat1(SunIntensity));
+
+			FLinearColor& Out = OutInScatteredLight[First + Lane];
+			VectorStore(Sample, &Out.R);
+			if (HueShift)
+			{
+				const FVector3f Color(Out.R, Out.G, Out.B);
+				const FVector3f Shifted = Color * CosAngle + (K ^ Color) * SinAngle + K * (K | Color) * (1 - CosAngle);
+				Out = FLinearColor(Shifted.X, Shifted.Y, Shifted.Z, Out.A);
+			}
+		}
+	});
+}
+
+FLinearColor FAtmosphereQuery::SampleTransmittanceTexture(const FVector2f& UV) const
+{
+	FLinearColor Sample;
+	VectorStore(SampleBilinear(TransmittanceTexels, TransmittanceSize, UV.X, UV.Y), &Sample.R);
+	return Sample;
+}
+
+FLinearColor FAtmosphereQuery::SampleInScatteredLightTexture(const FVector3f& UVW) const
+{
+	FLinearColor Sample;
+	VectorStore(InScatteredLightSize.Z > 0
+			? SampleTrilinear(InScatteredLightTexels, InScatteredLightSize, UVW.X, UVW.Y, UVW.Z)
+			: SampleBilinear(InScatteredLightTexels, InScatteredLightSize, UVW.Y, UVW.Z),
+		&Sample.R);
+	return Sample;
+}
@@ -0,0 +1,117 @@
+#include "AtmosphereDefinition.h"
+#include "AtmospherePrecompute.h"
+#include "AtmosphereQuery.h"
+#include "SweetAtmosphereShaders/Public/Rendering/AtmosphereTextureSampler.h"
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+
+/**
+ * The largest acceptable difference between FAtmosphereQuery and hardware filtered samples,
+ * relative to the brightest sample of each texture. GPUs interpolate with fixed point weights of 8 bits or more.
+ */
+static constexpr float MaxQueryError = 0.01f;
+
+/**
+ * The amount of random texture coordinates to compare.
+ */
+static constexpr int32 NumRandomSamples = 4096;
+
+/**
+ * @return The largest difference of two sets of samples, relative to the brightest reference sample.
+ */
+static float ComputeRelativeError(TConstArrayView<FLinearColor> Reference, TConstArrayView<FLinearColor> Samples)
+{
+	check(Reference.Num() == Samples.Num());
+
+	float Peak = 0;
+	float MaxDifference = 0;
+	for (int32 i = 0; i < Reference.Num(); i++)
+	{
+		const FLinearColor Difference = Samples[i] - Reference[i];
+		Peak = FMath::Max(Peak, FMath::Max3(Reference[i].R, Reference[i].G, Reference[i].B));
+		MaxDifference = FMath::Max(MaxDifference, FMath::Max3(FMath::Abs(Difference.R), FMath::Abs(Difference.G), FMath::Abs(Difference.B)));
+	}
+	return Peak > 0 ? MaxDifference / Peak : 0;
+}
+
+static void LogResult(const TCHAR* Name, const float Error)
+{
+	if (Error > MaxQueryError)
+	{
+		UE_LOG(LogTemp, Error, TEXT("FAtmosphereQuery %s samples differ from the GPU by %g relative to the peak, more than the allowed %g."),
+			Name, Error, MaxQueryError);
+	}
+	else
+	{
+		UE_LOG(LogTemp, Display, TEXT("FAtmosphereQuery %s samples differ from the GPU by %g relative to the peak, within the allowed %g."),
+			Name, Error, MaxQueryError);
+	}
+}
+
+static void ValidateQuery(const TArray<FString>& Args)
+{
+	const UAtmosphereDefinition* Definition = Args.IsEmpty() ? nullptr : LoadObject<UAtmosphereDefinition>(nullptr, *Args[0]);
+	if (!Definition)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: r.SweetAtmosphere.ValidateQuery <atmosphere definition path>"));
+		return;
+	}
+
+	// FAtmosphereQuery only reads PF_FloatRGBA texture data
+	FPrecomputedTextureSettings TextureSettings = Definition->TextureSettings;
+	TextureSettings.CompactTextureFormat = false;
+	TextureSettings.ComputeStatistics = false;
+	TextureSettings.DebugReadbackSlices.Empty();
+	const FPrecomputeContext Ctx = CreatePrecomputeContext(TextureSettings, Definition->AtmosphereSettings);
+	const FAtmosphereSettings AtmosphereSettings = Definition->AtmosphereSettings;
+
+	// sample at and beyond the edges of every axis, where coordinates are clamped, and at random coordinates in between
+	TArray<FVector3f> UVWs;
+	for (const float Edge : { -0.1f, 0.f, 1.f, 1.1f })
+	{
+		UVWs.Add(FVector3f(Edge, Edge, Edge));
+		UVWs.Add(FVector3f(Edge, 0.5f, 0.5f));
+		UVWs.Add(FVector3f(0.5f, Edge, 0.5f));
+		UVWs.Add(FVector3f(0.5f, 0.5f, Edge));
+	}
+	const FRandomStream Random(0);
+	while (UVWs.Num() < NumRandomSamples)
+	{
+		UVWs.Add(FVector3f(Random.GetFraction(), Random.GetFraction(), Random.GetFraction()));
+	}
+
+	FAtmospherePrecomputeShaderDispatcher::DispatchFuture(TextureSettings, Ctx, false).Next([TextureSettings, AtmosphereSettings, UVWs](FAtmospherePrecomputeResult Result) {
+		if (!Result.TextureData.Succeeded)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Failed to precompute the textures to compare."));
+			return;
+		}
+
+		// sample on the CPU before the texture data is moved to the render thread
+		const FAtmosphereQuery Query(Result.TextureData, TextureSettings, AtmosphereSettings);
+		TArray<FLinearColor> Transmittance, InScatteredLight;
+		for (const FVector3f& UVW : UVWs)
+		{
+			Transmittance.Add(Query.SampleTransmittanceTexture(FVector2f(UVW.X, UVW.Y)));
+			InScatteredLight.Add(Query.SampleInScatteredLightTexture(UVW));
+		}
+
+		FAtmosphereTextureSampler::SampleFuture(MoveTemp(Result.TextureData), UVWs).Next(
+			[Transmittance = MoveTemp(Transmittance), InScatteredLight = MoveTemp(InScatteredLight)](FAtmosphereTextureSamples Samples) {
+				if (!Samples.Succeeded)
+				{
+					UE_LOG(LogTemp, Error, TEXT("Failed to sample the textures on the GPU."));
+					return;
+				}
+
+				LogResult(TEXT("transmittance"), ComputeRelativeError(Samples.Transmittance, Transmittance));
+				LogResult(TEXT("in-scattered light"), ComputeRelativeError(Samples.InScatteredLight, InScatteredLight));
+			});
+	});
+}
+
+static FAutoConsoleCommand ValidateQueryCommand(
+	TEXT("r.SweetAtmosphere.ValidateQuery"),
+	TEXT("Precomputes the given atmosphere definition and logs whether FAtmosphereQuery samples the textures\n")
+	TEXT("within the allowed error of the GPU's linear clamped sampler."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&ValidateQuery));
@@ -0,0 +1,361 @@
+#include "AtmosphereResidencySubsystem.h"
+
+#include "Engine/World.h"
+#include "SweetAtmosphereShaders/Public/Precompute/PrecomputeScalability.h"
+
+FAtmosphereResidencyHandle UAtmosphereResidencySubsystem::Register(
+	USceneComponent* Anchor,
+	const float PlanetRadius,
+	const FPrecomputedTextureSettings& TextureSettings,
+	const FAtmosphereSettings& AtmosphereSettings,
+	TFunction<void(const FAtmospherePrecomputedTextures&)> OnTexturesChanged)
+{
+	check(IsInGameThread());
+	check(Anchor);
+
+	FAtmosphereResidencyEntry Entry;
+	Entry.Id = NextId++;
+	Entry.Anchor = Anchor;
+	Entry.PlanetRadius = PlanetRadius;
+	Entry.TextureSettings = TextureSettings;
+	Entry.AtmosphereSettings = AtmosphereSettings;
+	Entry.OnTexturesChanged = MoveTemp(OnTexturesChanged);
+
+	const FAtmosphereResidencyHandle Handle{ Entry.Id };
+	Entries.Add(MoveTemp(Entry));
+	return Handle;
+}
+
+FAtmosphereResidencyHandle UAtmosphereResidencySubsystem::RegisterAtmosphere(
+	USceneComponent* Anchor,
+	const float PlanetRadius,
+	const FPrecomputedTextureSettings& TextureSettings,
+	const FAtmosphereSettings& AtmosphereSettings,
+	FOnAtmosphereResidentTexturesChanged OnTexturesChanged)
+{
+	if (!Anchor)
+	{
+		UE_LOG(LogBlueprint, Error, TEXT("Register needs an anchor component at the planet origin"));
+		return FAtmosphereResidencyHandle();
+	}
+
+	return Register(Anchor, PlanetRadius, TextureSettings, AtmosphereSettings,
+		[OnTexturesChanged](const FAtmospherePrecomputedTextures& Textures) {
+			OnTexturesChanged.ExecuteIfBound(Textures);
+		});
+}
+
+void UAtmosphereResidencySubsystem::Unregister(const FAtmosphereResidencyHandle Handle)
+{
+	check(IsInGameThread());
+
+	const int32 Index = Entries.IndexOfByPredicate([Handle](const FAtmosphereResidencyEntry& Entry) {
+		return Entry.Id == Handle.Id;
+	});
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	if (Entries[Index].PendingJob.IsValid())
+	{
+		FAtmospherePrecomputeScheduler::Get().Cancel(Entries[Index].PendingJob);
+	}
+	Entries.RemoveAt(Index);
+}
+
+uint64 UAtmosphereResidencySubsystem::GetResidentBytes() const
+{
+	uint64 NumBytes = 0;
+	for (const auto& Entry : Entries)
+	{
+		if (Entry.Textures.TransmittanceTexture && Entry.NumBytesPerTier.IsValidIndex(Entry.Tier))
+		{
+			NumBytes += Entry.NumBytesPerTier[Entry.Tier];
+		}
+	}
+	return NumBytes;
+}
+
+uint64 UAtmosphereResidencySubsystem::EstimateBytes(const FPrecomputedTextureSettings& TextureSettings)
+{
+	const uint64 TransmittanceBytes = GPixelFormats[TextureSettings.CompactTextureFormat ? PF_FloatR11G11B10 : PF_FloatRGBA].BlockBytes
+		* TextureSettings.TransmittanceTextureWidth * TextureSettings.TransmittanceTextureHeight;
+	const uint64 InScatteredLightBytes = GPixelFormats[TextureSettings.UseCompactInScatteredLightFormat() ? PF_FloatR11G11B10 : PF_FloatRGBA].BlockBytes
+		* TextureSettings.GetNumInScatteredLightTexels();
+	return TransmittanceBytes + InScatteredLightBytes;
+}
+
+uint64 UAtmosphereResidencySubsystem::EstimateResidentBytes(const FPrecomputedTextureSettings& TextureSettings)
+{
+	check(IsInGameThread());
+	return EstimateBytes(FAtmosphereScalability::Apply(TextureSettings));
+}
+
+void UAtmosphereResidencySubsystem::Tick(const float DeltaTime)
+{
+	const UWorld* World = GetWorld();
+	if (!World || World->ViewLocationsRenderedLastFrame.IsEmpty())
+	{
+		return;
+	}
+
+	// forget about atmospheres whose anchor has been destroyed without unregistering
+	Entries.RemoveAll([](const FAtmosphereResidencyEntry& Entry) {
+		if (!Entry.Anchor.IsValid() && Entry.PendingJob.IsValid())
+		{
+			FAtmospherePrecomputeScheduler::Get().Cancel(Entry.PendingJob);
+		}
+		return !Entry.Anchor.IsValid();
+	});
+
+	UpdateImportance(World->ViewLocationsRenderedLastFrame);
+
+	// visit atmospheres from most to least important
+	TArray<int32> Order;
+	Order.Reserve(Entries.Num());
+	for (int32 i = 0; i < Entries.Num(); i++)
+	{
+		Order.Add(i);
+	}
+	Order.Sort([this](const int32 A, const int32 B) {
+		return Entries[A].Importance > Entries[B].Importance;
+	});
+
+	// pending precomputations count towards the budget at their target tier, since they will be resident soon.
+	// first make as many atmospheres resident as possible at the lowest tier, most important first.
+	const int32 LowestTier = FMath::Max(1, NumQualityTiers) - 1;
+	TArray<int32> TargetTiers;
+	TargetTiers.Init(INDEX_NONE, Entries.Num());
+	uint64 RemainingBytes = FMath::Max<int64>(0, MemoryBudget);
+	for (const int32 Index : Order)
+	{
+		auto& Entry = Entries[Index];
+		const bool IsResident = Entry.Textures.TransmittanceTexture || Entry.PendingJob.IsValid();
+		if (!IsResident && Entry.PrecomputeFailed)
+		{
+			// nothing is resident, and it isn't precomputed again until the quality level changes
+			continue;
+		}
+
+		// failed atmospheres keep their current textures
+		const int32 Tier = Entry.PrecomputeFailed ? Entry.Tier : LowestTier;
+		const float RequiredImportance = IsResident ? MinImportance * EvictionHysteresis : MinImportance;
+		if (Entry.Importance >= RequiredImportance && GetNumBytes(Entry, Tier) <= RemainingBytes)
+		{
+			RemainingBytes -= GetNumBytes(Entry, Tier);
+			TargetTiers[Index] = Tier;
+		}
+	}
+
+	// then upgrade them in the same order, so the least important atmospheres stay downgraded
+	for (const int32 Index : Order)
+	{
+		auto& Entry = Entries[Index];
+		if (TargetTiers[Index] == INDEX_NONE || Entry.PrecomputeFailed)
+		{
+			continue;
+		}
+
+		const uint64 TargetBytes = GetNumBytes(Entry, TargetTiers[Index]);
+		for (int32 Tier = 0; Tier < TargetTiers[Index]; Tier++)
+		{
+			const uint64 AdditionalBytes = GetNumBytes(Entry, Tier) - TargetBytes;
+			if (AdditionalBytes <= RemainingBytes)
+			{
+				RemainingBytes -= AdditionalBytes;
+				TargetTiers[Index] = Tier;
+				break;
+			}
+		}
+	}
+
+	for (const int32 Index : Order)
+	{
+		auto& Entry = Entries[Index];
+		const int32 TargetTier = TargetTiers[Index];
+		if (TargetTier == INDEX_NONE)
+		{
+			Evict(Entry);
+		}
+		else if (Entry.PrecomputeFailed)
+		{
+			continue;
+		}
+		else if (!Entry.PendingJob.IsValid())
+		{
+			if (!Entry.Textures.TransmittanceTexture || Entry.Tier != TargetTier)
+			{
+				MakeResident(Entry, TargetTier);
+			}
+		}
+		else if (Entry.PendingTier < TargetTier)
+		{
+			// the pending textures don't fit anymore. upgrades wait for the pending precomputation instead.
+			FAtmospherePrecomputeScheduler::Get().Cancel(Entry.PendingJob);
+			MakeResident(Entry, TargetTier);
+		}
+		else
+		{
+			// more important atmospheres are precomputed first
+			FAtmospherePrecomputeScheduler::Get().SetPriority(Entry.PendingJob, -Entry.Importance);
+		}
+	}
+}
+
+TStatId UAtmosphereResidencySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAtmosphereResidencySubsystem, STATGROUP_Tickables);
+}
+
+void UAtmosphereResidencySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	ScalabilityChangedHandle = FAtmosphereScalability::OnChanged().AddUObject(this, &UAtmosphereResidencySubsystem::OnScalabilityChanged);
+}
+
+void UAtmosphereResidencySubsystem::Deinitialize()
+{
+	FAtmosphereScalability::OnChanged().Remove(ScalabilityChangedHandle);
+
+	for (const auto& Entry : Entries)
+	{
+		if (Entry.PendingJob.IsValid())
+		{
+			FAtmospherePrecomputeScheduler::Get().Cancel(Entry.PendingJob);
+		}
+	}
+	Entries.Empty();
+
+	Super::Deinitialize();
+}
+
+void UAtmosphereResidencySubsystem::UpdateImportance(const TArray<FVector>& ViewLocations)
+{
+	for (auto& Entry : Entries)
+	{
+		const FVector PlanetOrigin = Entry.Anchor->GetComponentLocation();
+		const double AtmosphereRadius = Entry.PlanetRadius * (1 + Entry.AtmosphereSettings.AtmosphereScale);
+
+		Entry.Importance = 0;
+		for (const FVector& ViewLocation : ViewLocations)
+		{
+			// the angular radius of the atmosphere, relative to a view filled by it
+			const double Distance = FVector::Dist(ViewLocation, PlanetOrigin);
+			const double SinAngle = Distance > AtmosphereRadius ? AtmosphereRadius / Distance : 1;
+			Entry.Importance = FMath::Max(Entry.Importance, FMath::Asin(SinAngle) / UE_HALF_PI);
+		}
+	}
+}
+
+FPrecomputedTextureSettings UAtmosphereResidencySubsystem::GetTierSettings(const FPrecomputedTextureSettings& TextureSettings, const int32 Tier)
+{
+	// never go below the smallest resolution FAtmosphereScalability scales to
+	auto Downgrade = [Tier](const int32 Value) {
+		return Value > 0 ? FMath::Max(FMath::Min(Value, 4), Value >> Tier) : 0;
+	};
+
+	FPrecomputedTextureSettings Downgraded = TextureSettings;
+	Downgraded.TransmittanceTextureWidth = Downgrade(TextureSettings.TransmittanceTextureWidth);
+	Downgraded.TransmittanceTextureHeight = Downgrade(TextureSettings.TransmittanceTextureHeight);
+	Downgraded.InScatteredLightTextureSize = Downgrade(TextureSettings.InScatteredLightTextureSize);
+
+	// axes left at 0 keep following InScatteredLightTextureSize
+	Downgraded.InScatteredLightTextureDimensions = FIntVector(
+		Downgrade(TextureSettings.InScatteredLightTextureDimensions.X),
+		Downgrade(TextureSettings.InScatteredLightTextureDimensions.Y),
+		Downgrade(TextureSettings.InScatteredLightTextureDimensions.Z));
+	return Downgraded;
+}
+
+uint64 UAtmosphereResidencySubsystem::GetNumBytes(FAtmosphereResidencyEntry& Entry, const int32 Tier)
+{
+	while (Entry.NumBytesPerTier.Num() <= Tier)
+	{
+		Entry.NumBytesPerTier.Add(EstimateResidentBytes(GetTierSettings(Entry.TextureSettings, Entry.NumBytesPerTier.Num())));
+	}
+	return Entry.NumBytesPerTier[Tier];
+}
+
+void UAtmosphereResidencySubsystem::MakeResident(FAtmosphereResidencyEntry& Entry, const int32 Tier)
+{
+	Entry.PendingTier = Tier;
+	Entry.PendingJob = UAtmospherePrecomputeAction::PrecomputeAtmosphericScattering(
+		GetTierSettings(Entry.TextureSettings, Tier),
+		Entry.AtmosphereSettings,
+		false,
+		[WeakThis = TWeakObjectPtr<UAtmosphereResidencySubsystem>(this), Id = Entry.Id, Tier](const FAtmospherePrecomputedTextures& Textures, const FAtmospherePrecomputeDebugTextures&) {
+			if (WeakThis.IsValid())
+			{
+				WeakThis->OnTexturesPrecomputed(Id, Tier, Textures);
+			}
+		},
+		Entry.Anchor.Get(),
+		-Entry.Importance);
+}
+
+void UAtmosphereResidencySubsystem::Evict(FAtmosphereResidencyEntry& Entry)
+{
+	if (Entry.PendingJob.IsValid())
+	{
+		FAtmospherePrecomputeScheduler::Get().Cancel(Entry.PendingJob);
+		Entry.PendingJob = FAtmospherePrecomputeJobHandle();
+	}
+
+	if (Entry.Textures.TransmittanceTexture)
+	{
+		// the textures are released once no material references them anymore
+		Entry.Textures = FAtmospherePrecomputedTextures();
+		if (Entry.OnTexturesChanged)
+		{
+			Entry.OnTexturesChanged(Entry.Textures);
+		}
+	}
+}
+
+void UAtmosphereResidencySubsystem::OnTexturesPrecomputed(const uint64 Id, const int32 Tier, const FAtmospherePrecomputedTextures& Textures)
+{
+	auto* Entry = Entries.FindByPredicate([Id](const FAtmosphereResidencyEntry& Entry) {
+		return Entry.Id == Id;
+	});
+	if (!Entry)
+	{
+		return;
+	}
+
+	Entry->PendingJob = FAtmospherePrecomputeJobHandle();
+	if (!Textures.TransmittanceTexture)
+	{
+		// keep any current textures, and don't try again every tick
+		Entry->PrecomputeFailed = true;
+		return;
+	}
+
+	Entry->Textures = Textures;
+	Entry->Tier = Tier;
+	if (Entry->OnTexturesChanged)
+	{
+		Entry->OnTexturesChanged(Entry->Textures);
+	}
+}
+
+void UAtmosphereResidencySubsystem::OnScalabilityChanged()
+{
+	for (auto& Entry : Entries)
+	{
+		Entry.NumBytesPerTier.Empty();
+		Entry.PrecomputeFailed = false;
+
+		// evicted atmospheres pick up the new quality level once they become resident again
+		if (Entry.Anchor.IsValid() && (Entry.Textures.TransmittanceTexture || Entry.PendingJob.IsValid()))
+		{
+			const int32 Tier = Entry.PendingJob.IsValid() ? Entry.PendingTier : Entry.Tier;
+			if (Entry.PendingJob.IsValid())
+			{
+				FAtmospherePrecomputeScheduler::Get().Cancel(Entry.PendingJob);
+			}
+			MakeResident(Entry, Tier);
+		}
+	}
+}
@@ -1,10 +1,35 @@
 #include "DebugTextureHelper.h"
 
-#include "IImageWrapperModule.h"
 #include "ImagePixelData.h"
+#include "Async/Async.h"
 #include "ImageWriteBlueprintLibrary.h"
+#include "ImageWriteQueue.h"
+#include "ImageWriteTask.h"
 #include "Engine/VolumeTexture.h"
 
+/**
+ * Enqueues an EXR file to be encoded and written on a worker thread.
+ *
+ * @param PixelData The pixel data to write.
+ * @param Filepath The output filename including path and extension.
+ */
+static void EnqueueEXRWrite(TUniquePtr<FImagePixelData>&& PixelData, const FString& Filepath)
+{
+	auto Task = MakeUnique<FImageWriteTask>();
+	Task->PixelData = MoveTemp(PixelData);
+	Task->Filename = Filepath;
+	Task->Format = EImageFormat::EXR;
+	Task->bOverwriteFile = true;
+	Task->OnCompleted = [Filepath](const bool Success) {
+		if (!Success)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Failed to save EXR file %s."), *Filepath);
+		}
+	};
+
+	IImageWriteQueueModule::Get().GetWriteQueue().Enqueue(MoveTemp(Task));
+}
+
 void UDebugTextureHelper::SaveTextureToEXR(UTexture* Texture, const FString& FilepathNoExtension)
 {
 	if (UTexture2D* Tex2D = Cast<UTexture2D>(Texture))
@@ -24,23 +49,10 @@ void UDebugTextureHelper::SaveTextureToEXR(UTexture* Texture, const FString& Fil
 void UDebugTextureHelper::SaveTexture2DToEXR(UTexture2D* Texture, const FString& FilepathNoExtension)
 {
 	const FString Filepath = FilepathNoExtension + ".exr";
-	const int Width = Texture->GetSizeX();
-	const int Height = Texture->GetSizeY();
 
 	UImageWriteBlueprintLibrary::ResolvePixelData(Texture,
-		[Filepath, Width, Height](TUniquePtr<FImagePixelData>&& PixelData) {
-			const void* RawData;
-			int64 Size;
-			PixelData->GetRawData(RawData, Size);
-
-			auto& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName("ImageWrapper"));
-			const auto ImageWrapper = ImageWrapperModule.CreateImageWrapper(EImageFormat::EXR);
-
-			if (ImageWrapper.IsValid() && ImageWrapper->SetRaw(RawData, Size, Width, Height, PixelData->GetPixelLayout(), PixelData->GetBitDepth()))
-			{
-				const TArray64<uint8>& ImageData = ImageWrapper->GetCompressed();
-				FFileHelper::SaveArrayToFile(ImageData, *Filepath);
-			}
+		[Filepath](TUniquePtr<FImagePixelData>&& PixelData) {
+			EnqueueEXRWrite(MoveTemp(PixelData), Filepath);
 		});
 }
 
@@ -52,28 +64,66 @@ void UDebugTextureHelper::SaveVolumeTextureToEXR(UVolumeTexture* VolumeTexture,
 	// Ensure the format is PF_FloatRGBA.
 	check(Format == PF_FloatRGBA);
 
-	auto& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName("ImageWrapper"));
-	const auto ImageWrapper = ImageWrapperModule.CreateImageWrapper(EImageFormat::EXR);
-
 	const int32 Width = VolumeTexture->GetSizeX();
 	const int32 Height = VolumeTexture->GetSizeY();
 	const int32 Depth = VolumeTexture->GetSizeZ();
+	const int64 SliceSize = static_cast<int64>(Width) * Height;
 
-	const uint16* Data = static_cast<uint16*>(PlatformData->Mips[0].BulkData.Lock(LOCK_READ_ONLY));
+	// copy every slice out once so the bulk data lock is only held for the copy,
+	// encoding happens in parallel on the image write queue's worker threads.
+	const auto* Data = static_cast<const FFloat16Color*>(PlatformData->Mips[0].BulkData.LockReadOnly());
 
 	for (int32 SliceIndex = 0; SliceIndex < Depth; ++SliceIndex)
 	{
-		if (ImageWrapper.IsValid() && ImageWrapper->SetRaw(Data + SliceIndex * Width * Height * 4, Width * Height * 4 * sizeof(uint16), Width, Height, ERGBFormat::RGBAF, 16))
-		{
-			const TArray64<uint8>& PNGData = ImageWrapper->GetCompressed();
-			const FString FullFilePath = FilepathNoExtension + FString::Printf(TEXT("_%d.exr"), SliceIndex);
-
-			if (!FFileHelper::SaveArrayToFile(PNGData, *FullFilePath))
-			{
-				UE_LOG(LogTemp, Warning, TEXT("Failed to save EXR file for slice %d."), SliceIndex);
-			}
-		}
+		TArray64<FFloat16Color> Pixels(Data + SliceIndex * SliceSize, SliceSize);
+		auto PixelData = MakeUnique<TImagePixelData<FFloat16Color>>(FIntPoint(Width, Height), MoveTemp(Pixels));
+		EnqueueEXRWrite(MoveTemp(PixelData), FilepathNoExtension + FString::Printf(TEXT("_%d.exr"), SliceIndex));
 	}
 
 	PlatformData->Mips[0].BulkData.Unlock();
 }
+
+void UDebugTextureHelper::SaveVolumeTextureToDDS(UVolumeTexture* VolumeTexture, const FString& FilepathNoExtension)
+{
+	auto* PlatformData = VolumeTexture->GetPlatformData();
+	check(PlatformData->PixelFormat == PF_FloatRGBA);
+
+	const uint32 Width = VolumeTexture->GetSizeX();
+	const uint32 Height = VolumeTexture->GetSizeY();
+	const uint32 Depth = VolumeTexture->GetSizeZ();
+	const int64 NumBytes = static_cast<int64>(Width) * Height * Depth * sizeof(FFloat16Color);
+
+	// DDS file with DX10 extension header, see
+	// https://learn.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+	constexpr uint32 HeaderSize = 4 + 124 + 20;
+	uint32 Header[HeaderSize / sizeof(uint32)] = {};
+	Header[0] = MAKEFOURCC('D', 'D', 'S', ' ');
+	Header[1] = 124; // dwSize
+	Header[2] = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000 | 0x800000; // dwFlags: CAPS | HEIGHT | WIDTH | PITCH | PIXELFORMAT | DEPTH
+	Header[3] = Height;
+	Header[4] = Width;
+	Header[5] = Width * sizeof(FFloat16Color); // dwPitchOrLinearSize
+	Header[6] = Depth;
+	Header[19] = 32; // ddspf.dwSize
+	Header[20] = 0x4; // ddspf.dwFlags: FOURCC
+	Header[21] = MAKEFOURCC('D', 'X', '1', '0'); // ddspf.dwFourCC
+	Header[27] = 0x1000 | 0x8; // dwCaps: TEXTURE | COMPLEX
+	Header[28] = 0x200000; // dwCaps2: VOLUME
+	Header[32] = 10; // dxgiFormat: DXGI_FORMAT_R16G16B16A16_FLOAT
+	Header[33] = 4; // resourceDimension: D3D10_RESOURCE_DIMENSION_TEXTURE3D
+	Header[35] = 1; // arraySize
+
+	TArray64<uint8> FileData;
+	FileData.SetNumUninitialized(HeaderSize + NumBytes);
+	FMemory::Memcpy(FileData.GetData(), Header, HeaderSize);
+	FMemory::Memcpy(FileData.GetData() + HeaderSize, PlatformData->Mips[0].BulkData.LockReadOnly(), NumBytes);
+	PlatformData->Mips[0].BulkData.Unlock();
+
+	const FString Filepath = FilepathNoExtension + ".dds";
+	Async(EAsyncExecution::ThreadPool, [FileData = MoveTemp(FileData), Filepath] {
+		if (!FFileHelper::SaveArrayToFile(FileData, *Filepath))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Failed to save DDS file %s."), *Filepath);
+		}
+	});
+}
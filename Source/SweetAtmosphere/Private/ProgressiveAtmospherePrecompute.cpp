@@ -0,0 +1,117 @@
+#include "ProgressiveAtmospherePrecompute.h"
+
+#include "Materials/MaterialInstanceDynamic.h"
+#include "SweetAtmosphereShaders/Public/Precompute/PrecomputeScalability.h"
+
+UProgressiveAtmospherePrecompute::UProgressiveAtmospherePrecompute()
+{
+	PreviewTextureSettings.TransmittanceTextureWidth = 64;
+	PreviewTextureSettings.TransmittanceTextureHeight = 64;
+	PreviewTextureSettings.InScatteredLightTextureSize = 32;
+	PreviewTextureSettings.TransmittanceSampleSteps = 8;
+	PreviewTextureSettings.InScatteredLightSampleSteps = 8;
+
+	if (!HasAnyFlags(RF_ClassDefaultObject))
+	{
+		ScalabilityChangedHandle = FAtmosphereScalability::OnChanged().AddUObject(this, &UProgressiveAtmospherePrecompute::OnScalabilityChanged);
+	}
+}
+
+UProgressiveAtmospherePrecompute* UProgressiveAtmospherePrecompute::CreateProgressivePrecompute(
+	UMaterialInstanceDynamic* MaterialInstance,
+	const FPrecomputedTextureSettings& TextureSettings)
+{
+	auto* Precompute = NewObject<UProgressiveAtmospherePrecompute>();
+	Precompute->MaterialInstance = MaterialInstance;
+	Precompute->TextureSettings = TextureSettings;
+	return Precompute;
+}
+
+void UProgressiveAtmospherePrecompute::Update(const FAtmosphereSettings& _AtmosphereSettings)
+{
+	AtmosphereSettings = _AtmosphereSettings;
+	Generation++;
+	IsRefined = false;
+
+	// only lower the resolutions and sample steps, e.g. OuterShellOnly changes the layout of the in-scattered light texture
+	FPrecomputedTextureSettings Preview = TextureSettings;
+	Preview.TransmittanceTextureWidth = PreviewTextureSettings.TransmittanceTextureWidth;
+	Preview.TransmittanceTextureHeight = PreviewTextureSettings.TransmittanceTextureHeight;
+	Preview.InScatteredLightTextureSize = PreviewTextureSettings.InScatteredLightTextureSize;
+	Preview.InScatteredLightTextureDimensions = PreviewTextureSettings.InScatteredLightTextureDimensions;
+	Preview.TransmittanceSampleSteps = PreviewTextureSettings.TransmittanceSampleSteps;
+	Preview.InScatteredLightSampleSteps = PreviewTextureSettings.InScatteredLightSampleSteps;
+	Precompute(Preview, true);
+
+	// (re)start the refinement countdown
+	FTSTicker::GetCoreTicker().RemoveTicker(RefinementTickerHandle);
+	RefinementTickerHandle = FTSTicker::GetCoreTicker().AddTicker(
+		FTickerDelegate::CreateUObject(this, &UProgressiveAtmospherePrecompute::Refine),
+		RefinementDelay);
+}
+
+void UProgressiveAtmospherePrecompute::BeginDestroy()
+{
+	FTSTicker::GetCoreTicker().RemoveTicker(RefinementTickerHandle);
+	FAtmosphereScalability::OnChanged().Remove(ScalabilityChangedHandle);
+	Super::BeginDestroy();
+}
+
+bool UProgressiveAtmospherePrecompute::Refine(float DeltaTime)
+{
+	Precompute(TextureSettings, false);
+
+	// only fire once
+	RefinementTickerHandle.Reset();
+	return false;
+}
+
+void UProgressiveAtmospherePrecompute::OnScalabilityChanged()
+{
+	if (Generation == 0 || RefinementTickerHandle.IsValid())
+	{
+		// nothing has been precomputed yet, or the refinement is still pending
+		return;
+	}
+
+	// keep the current textures bound until the final textures of the new quality level are ready
+	Generation++;
+	IsRefined = false;
+	Precompute(TextureSettings, false);
+}
+
+void UProgressiveAtmospherePrecompute::Precompute(const FPrecomputedTextureSettings& Settings, const bool IsPreview)
+{
+	// preview and final precomputation share an owner,
+	// so a new update replaces any queued precomputation for outdated settings
+	TWeakObjectPtr<UProgressiveAtmospherePrecompute> WeakThis(this);
+	UAtmospherePrecomputeAction::PrecomputeAtmosphericScattering(
+		Settings, AtmosphereSettings, false,
+		[WeakThis, ForGeneration = Generation, IsPreview](FAtmospherePrecomputedTextures NewTextures, FAtmospherePrecomputeDebugTextures DebugTextures) {
+			auto* This = WeakThis.Get();
+			if (!This || This->Generation != ForGeneration || This->IsRefined)
+			{
+				// the settings have changed, or the final textures are already bound
+				return;
+			}
+			if (!NewTextures.TransmittanceTexture)
+			{
+				// precomputation failed, keep the current textures bound
+				return;
+			}
+
+			This->Textures = NewTextures;
+			if (This->MaterialInstance)
+			{
+				UAtmosphereMaterialHelper::BindPrecomputedTextures(This->MaterialInstance, NewTextures);
+				UAtmosphereMaterialHelper::BindAtmosphereSettings(This->MaterialInstance, This->AtmosphereSettings);
+			}
+
+			if (!IsPreview)
+			{
+				This->IsRefined = true;
+				This->OnRefined.Broadcast(NewTextures, DebugTextures);
+			}
+		},
+		this, IsPreview ? -1 : 0);
+}
@@ -0,0 +1,6 @@
+#include "ReducedResolutionAtmosphereComponent.h"
+
+bool UReducedResolutionAtmosphereComponent::ShouldRenderAtReducedResolution() const
+{
+	return RenderAtReducedResolution;
+}
@@ -0,0 +1,139 @@
+#include "AtmosphereDefinition.h"
+#include "AtmospherePrecompute.h"
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "RenderingThread.h"
+
+/**
+ * The largest acceptable root mean square difference between the in-scattered light precomputed with and without
+ * r.SweetAtmosphere.PrecomputeWaveIntrinsics, relative to the brightest texel of the groupshared memory texture.
+ * A fifth of the auto tuner's default FAtmosphereAutoTuneTarget::MaxError.
+ */
+static constexpr float MaxWaveIntrinsicsError = 0.001f;
+
+/**
+ * @return The root mean square difference of two PF_FloatRGBA textures relative to the reference's brightest texel,
+ *         or a negative value if they can't be compared.
+ */
+static float ComputeRelativeError(const FTextureData& Reference, const FTextureData& Data)
+{
+	if (Reference.Size != Data.Size || Reference.Data.Num() != Data.Data.Num() || Reference.PixelFormat != PF_FloatRGBA)
+	{
+		return -1;
+	}
+
+	const auto* ReferenceTexels = reinterpret_cast<const FFloat16Color*>(Reference.Data.GetData());
+	const auto* Texels = reinterpret_cast<const FFloat16Color*>(Data.Data.GetData());
+	const int32 NumTexels = Reference.Data.Num() / sizeof(FFloat16Color);
+
+	float Peak = 0;
+	double SumSquaredDifference = 0;
+	for (int32 i = 0; i < NumTexels; i++)
+	{
+		const FLinearColor ReferenceTexel = ReferenceTexels[i].GetFloats();
+		const FLinearColor Difference = Texels[i].GetFloats() - ReferenceTexel;
+		Peak = FMath::Max(Peak, ReferenceTexel.GetMax());
+		SumSquaredDifference += FMath::Square(Difference.R) + FMath::Square(Difference.G) + FMath::Square(Difference.B);
+	}
+	return NumTexels > 0 && Peak > 0 ? FMath::Sqrt(SumSquaredDifference / (3 * NumTexels)) / Peak : 0;
+}
+
+static IConsoleVariable* GetWaveIntrinsicsVariable()
+{
+	return IConsoleManager::Get().FindConsoleVariable(TEXT("r.SweetAtmosphere.PrecomputeWaveIntrinsics"));
+}
+
+/**
+ * Sets r.SweetAtmosphere.PrecomputeWaveIntrinsics to a value with the given priority.
+ * Setting a value with a lower priority than the current one is ignored,
+ * so the value is set with the highest priority and the priority is lowered afterwards.
+ */
+static void SetWaveIntrinsics(const int32 WaveIntrinsics, const EConsoleVariableFlags SetBy)
+{
+	IConsoleVariable* Variable = GetWaveIntrinsicsVariable();
+	Variable->Set(WaveIntrinsics, ECVF_SetByConsole);
+	Variable->SetFlags(EConsoleVariableFlags((Variable->GetFlags() & ~ECVF_SetByMask) | SetBy));
+}
+
+/**
+ * Precomputes the textures with r.SweetAtmosphere.PrecomputeWaveIntrinsics set to the given value.
+ * The dispatcher reads the console variable on the render thread, so it is flushed to the render thread first,
+ * and must not change again until the returned future has been fulfilled.
+ */
+static TFuture<FAtmospherePrecomputeResult> PrecomputeWithWaveIntrinsics(
+	const int32 WaveIntrinsics,
+	const FPrecomputedTextureSettings& TextureSettings,
+	const FPrecomputeContext& Ctx)
+{
+	SetWaveIntrinsics(WaveIntrinsics, ECVF_SetByConsole);
+	FlushRenderingCommands();
+	return FAtmospherePrecomputeShaderDispatcher::DispatchFuture(TextureSettings, Ctx, false);
+}
+
+static void ValidateWaveIntrinsics(const TArray<FString>& Args)
+{
+	if (!GRHISupportsWaveOperations)
+	{
+		UE_LOG(LogTemp, Display, TEXT("This GPU doesn't support wave operations, r.SweetAtmosphere.PrecomputeWaveIntrinsics has no effect."));
+		return;
+	}
+
+	const UAtmosphereDefinition* Definition = Args.IsEmpty() ? nullptr : LoadObject<UAtmosphereDefinition>(nullptr, *Args[0]);
+	if (!Definition)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: r.SweetAtmosphere.ValidateWaveIntrinsics <atmosphere definition path>"));
+		return;
+	}
+
+	// only the shared view ray kernel has a wave intrinsics variant
+	FPrecomputedTextureSettings TextureSettings = Definition->TextureSettings;
+	TextureSettings.ShareViewRaysAcrossSunAngles = true;
+	TextureSettings.AdaptiveRefinement = false;
+	TextureSettings.ComputeStatistics = false;
+	TextureSettings.DebugReadbackSlices.Empty();
+	const FPrecomputeContext Ctx = CreatePrecomputeContext(TextureSettings, Definition->AtmosphereSettings);
+
+	// restored once both textures have been precomputed, including the priority it was set with
+	const IConsoleVariable* Variable = GetWaveIntrinsicsVariable();
+	const int32 WaveIntrinsics = Variable->GetInt();
+	const EConsoleVariableFlags SetBy = EConsoleVariableFlags(Variable->GetFlags() & ECVF_SetByMask);
+
+	// precompute one after the other, so each dispatch sees its own console variable value
+	PrecomputeWithWaveIntrinsics(0, TextureSettings, Ctx).Next([TextureSettings, Ctx, WaveIntrinsics, SetBy](FAtmospherePrecomputeResult Reference) {
+		AsyncTask(ENamedThreads::GameThread, [Reference = MoveTemp(Reference), TextureSettings, Ctx, WaveIntrinsics, SetBy]() mutable {
+			PrecomputeWithWaveIntrinsics(1, TextureSettings, Ctx).Next([Reference = MoveTemp(Reference), WaveIntrinsics, SetBy](FAtmospherePrecomputeResult Result) mutable {
+				AsyncTask(ENamedThreads::GameThread, [Reference = MoveTemp(Reference), Result = MoveTemp(Result), WaveIntrinsics, SetBy]() {
+					SetWaveIntrinsics(WaveIntrinsics, SetBy);
+
+					if (!Reference.TextureData.Succeeded || !Result.TextureData.Succeeded)
+					{
+						UE_LOG(LogTemp, Error, TEXT("Failed to precompute the textures to compare."));
+						return;
+					}
+
+					const float Error = ComputeRelativeError(Reference.TextureData.InScatteredLightTextureData, Result.TextureData.InScatteredLightTextureData);
+					if (Error < 0)
+					{
+						UE_LOG(LogTemp, Error, TEXT("The precomputed in-scattered light textures can't be compared."));
+					}
+					else if (Error > MaxWaveIntrinsicsError)
+					{
+						UE_LOG(LogTemp, Error, TEXT("Wave intrinsics differ from groupshared memory by %g relative RMS, more than the allowed %g. Keep r.SweetAtmosphere.PrecomputeWaveIntrinsics disabled on this GPU."),
+							Error, MaxWaveIntrinsicsError);
+					}
+					else
+					{
+						UE_LOG(LogTemp, Display, TEXT("Wave intrinsics differ from groupshared memory by %g relative RMS, within the allowed %g."),
+							Error, MaxWaveIntrinsicsError);
+					}
+				});
+			});
+		});
+	});
+}
+
+static FAutoConsoleCommand ValidateWaveIntrinsicsCommand(
+	TEXT("r.SweetAtmosphere.ValidateWaveIntrinsics"),
+	TEXT("Precomputes the given atmosphere definition with and without r.SweetAtmosphere.PrecomputeWaveIntrinsics\n")
+	TEXT("and logs whether the in-scattered light stays within the allowed error of the groupshared memory kernel."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&ValidateWaveIntrinsics));
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "AerialPerspectiveVolumeComponent.generated.h"
+
+class UMaterialInstanceDynamic;
+class UTextureRenderTargetVolume;
+
+/**
+ * Provides the aerial perspective of the atmosphere around the camera to materials of objects inside it.
+ *
+ * Every frame, the light in-scattered between the camera and every froxel of a camera aligned volume,
+ * and the transmittance in between, are computed from the precomputed textures of the closest
+ * UAtmosphereComponent, whether or not it renders the atmosphere itself. Materials apply it with ApplyAerialPerspective from
+ * /SweetAtmosphere/Material/AerialPerspective.ush, which costs a single texture fetch.
+ * For that, the volume only stores the average transmittance of the color channels.
+ *
+ * Only a single volume is computed at a time, registering another component replaces it.
+ */
+UCLASS(ClassGroup = (Rendering), meta = (BlueprintSpawnableComponent))
+class SWEETATMOSPHERE_API UAerialPerspectiveVolumeComponent : public UActorComponent
+{
+	GENERATED_BODY()
+public:
+	/**
+	 * The amount of froxels along the screen's width, height and depth.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Aerial Perspective", meta = (ClampMin = 1))
+	FIntVector Resolution = FIntVector(32, 32, 32);
+
+	/**
+	 * The scene depth of the last slice, in world space units. Slices are distributed quadratically,
+	 * so close objects get more detail. Objects further away use the last slice.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Aerial Perspective", meta = (ClampMin = 1))
+	float MaxDistance = 1000000;
+
+	/**
+	 * The volume the aerial perspective is computed into, created on registration.
+	 */
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Aerial Perspective")
+	TObjectPtr<UTextureRenderTargetVolume> VolumeTexture;
+
+	/**
+	 * Sets the AerialPerspectiveVolume texture and AerialPerspectiveMaxDistance scalar parameters of a material.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Aerial Perspective")
+	void BindToMaterial(UMaterialInstanceDynamic* Material) const;
+
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AtmosphereSettings.h"
+#include "SweetAtmosphereShaders/Public/Precompute/PrecomputeShaderSettings.h"
+#include "Async/Future.h"
+#include "AtmosphereAutoTuner.generated.h"
+
+/**
+ * The goal of FAtmosphereAutoTuner.
+ */
+USTRUCT(BlueprintType)
+struct SWEETATMOSPHERE_API FAtmosphereAutoTuneTarget
+{
+	GENERATED_BODY()
+
+	/**
+	 * The largest acceptable error of either texture compared to the reference.
+	 * The error is the root mean square difference to the reference, relative to the reference's brightest texel.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float MaxError = 0.005f;
+
+	/**
+	 * The largest acceptable GPU memory of the tuned textures, in bytes. 0 means unlimited.
+	 * Takes precedence over MaxError. Applies to the tuned settings themselves, before any scalability scaling.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int64 MemoryBudget = 0;
+
+	/**
+	 * The high quality settings to compare against. Tuning starts at these settings and only ever reduces
+	 * resolutions and step counts, all other settings are kept.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FPrecomputedTextureSettings ReferenceSettings;
+
+	/**
+	 * The smallest amount of texels along any texture axis.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int MinTextureSize = 4;
+
+	/**
+	 * The smallest amount of ray marching steps.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int MinSampleSteps = 4;
+
+	FAtmosphereAutoTuneTarget()
+	{
+		ReferenceSettings.TransmittanceTextureWidth = 512;
+		ReferenceSettings.TransmittanceTextureHeight = 512;
+		ReferenceSettings.InScatteredLightTextureSize = 256;
+		ReferenceSettings.TransmittanceSampleSteps = 100;
+		ReferenceSettings.InScatteredLightSampleSteps = 200;
+	}
+};
+
+/**
+ * The settings found by FAtmosphereAutoTuner.
+ */
+USTRUCT(BlueprintType)
+struct SWEETATMOSPHERE_API FAtmosphereAutoTuneResult
+{
+	GENERATED_BODY()
+
+	/**
+	 * The cheapest settings found.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FPrecomputedTextureSettings TextureSettings;
+
+	/**
+	 * The error of the transmittance texture, see FAtmosphereAutoTuneTarget::MaxError.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float TransmittanceError = 0;
+
+	/**
+	 * The error of the in-scattered light texture, see FAtmosphereAutoTuneTarget::MaxError.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float InScatteredLightError = 0;
+
+	/**
+	 * The GPU memory of the tuned textures, in bytes, before any scalability scaling.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int64 NumBytes = 0;
+
+	/**
+	 * Whether the settings meet both the error target and the memory budget.
+	 * May be false if the memory budget forced a larger error,
+	 * or if the reference couldn't be precomputed, in which case TextureSettings are the reference settings.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool MeetsTarget = false;
+};
+
+/**
+ * Searches for the cheapest texture settings that reproduce an atmosphere within a given error.
+ *
+ * Starting at the reference settings, every round precomputes one candidate per tunable value
+ * (both transmittance axes, all three in-scattered light axes and both step counts), each with that value halved,
+ * and continues with the candidate of the lowest error that still meets the target.
+ * Once no value can be halved anymore, the same is done with smaller reductions.
+ * Thin atmospheres typically end up with few height texels and step counts, while the view angle keeps most of its detail.
+ * Candidates are precomputed at most FAtmospherePrecomputeScheduler::GetMaxConcurrentJobs at a time.
+ * Every round continues in a task that runs once its candidates have been precomputed, so no thread waits for the GPU.
+ */
+class SWEETATMOSPHERE_API FAtmosphereAutoTuner
+{
+public:
+	/**
+	 * Starts tuning on background worker threads. Can be called from any thread.
+	 * Tuning precomputes the atmosphere many times and may take a few seconds,
+	 * so it is meant to run in the editor or while loading, not every frame.
+	 *
+	 * @param AtmosphereSettings The atmosphere to tune the texture settings for.
+	 * @param Target The error target and memory budget.
+	 * @return A future that is fulfilled on a background worker thread.
+	 */
+	static TFuture<FAtmosphereAutoTuneResult> AutoTune(
+		const FAtmosphereSettings& AtmosphereSettings,
+		const FAtmosphereAutoTuneTarget& Target);
+};
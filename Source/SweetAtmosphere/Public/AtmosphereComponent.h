@@ -0,0 +1,76 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AtmosphereSettings.h"
+#include "Components/SceneComponent.h"
+#include "SweetAtmosphereShaders/Public/Precompute/PrecomputeShader.h"
+#include "AtmosphereComponent.generated.h"
+
+/**
+ * Describes an atmosphere around this component's location by its precomputed textures,
+ * so that a UAerialPerspectiveVolumeComponent can compute the aerial perspective of objects inside it.
+ *
+ * The atmosphere itself isn't rendered by this component. Render it with a material, e.g. on a UAtmosphereProxyComponent,
+ * or use a UReducedResolutionAtmosphereComponent instead, which renders it and provides aerial perspective as well.
+ */
+UCLASS(ClassGroup = (Rendering), meta = (BlueprintSpawnableComponent))
+class SWEETATMOSPHERE_API UAtmosphereComponent : public USceneComponent
+{
+	GENERATED_BODY()
+public:
+	UAtmosphereComponent(const FObjectInitializer& ObjectInitializer);
+
+	/**
+	 * The planet radius, in world space units.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Atmosphere")
+	float PlanetRadius = 100;
+
+	/**
+	 * The atmosphere settings the textures were precomputed with.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Atmosphere")
+	FAtmosphereSettings AtmosphereSettings;
+
+	/**
+	 * The precomputed textures of the atmosphere.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Atmosphere")
+	FAtmospherePrecomputedTextures PrecomputedTextures;
+
+	/**
+	 * The actor whose forward vector is used as the direction of light rays coming from the sun,
+	 * usually a directional light.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Atmosphere")
+	TObjectPtr<AActor> Sun;
+
+	/**
+	 * The direction of light rays coming from the sun, used if no sun actor is set.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Atmosphere")
+	FVector SunLightDirection = FVector(0, 0, -1);
+
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+	/**
+	 * @return Whether the atmosphere is rendered at a reduced resolution, in addition to providing aerial perspective.
+	 */
+	virtual bool ShouldRenderAtReducedResolution() const { return false; }
+
+private:
+	/**
+	 * The in-scattered light texture rotated to the current hue shift, if PrecomputedTextures
+	 * were precomputed with BakeHueShift, see UAtmosphereMaterialHelper::ResolveHueShift.
+	 */
+	UPROPERTY(Transient)
+	TObjectPtr<UTexture> RotatedInScatteredLightTexture;
+
+	/**
+	 * The texture of PrecomputedTextures RotatedInScatteredLightTexture was rotated from.
+	 */
+	TWeakObjectPtr<UTexture> RotatedFromTexture;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "AtmosphereSettings.h"
+#include "SweetAtmosphereShaders/Public/Precompute/PrecomputeShader.h"
+#include "Engine/DataAsset.h"
+#include "AtmosphereDefinition.generated.h"
+
+/**
+ * An authored atmosphere whose precomputed textures can be baked
+ * into texture assets ahead of time using the BakeAtmosphereTextures commandlet.
+ */
+UCLASS(BlueprintType)
+class SWEETATMOSPHERE_API UAtmosphereDefinition : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+public:
+	/**
+	 * The atmosphere settings.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Atmosphere")
+	FAtmosphereSettings AtmosphereSettings;
+
+	/**
+	 * The texture settings to precompute the atmosphere with.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Atmosphere")
+	FPrecomputedTextureSettings TextureSettings;
+
+	/**
+	 * Whether the BakeAtmosphereTextures commandlet should bake textures for this atmosphere.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Baking")
+	bool BakeTextures = true;
+
+#if WITH_EDITORONLY_DATA
+	/**
+	 * The compression settings to apply to baked textures.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Baking")
+	TEnumAsByte<TextureCompressionSettings> CompressionSettings = TC_HDR_Compressed;
+
+	/**
+	 * The mip generation settings to apply to baked textures.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Baking")
+	TEnumAsByte<TextureMipGenSettings> MipGenSettings = TMGS_NoMipmaps;
+#endif
+
+	/**
+	 * The baked transmittance texture.
+	 */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Baking")
+	TObjectPtr<UTexture2D> BakedTransmittanceTexture;
+
+	/**
+	 * The baked in-scattered light texture.
+	 * A 2D texture if TextureSettings.OuterShellOnly is set, a volume texture otherwise.
+	 */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Baking")
+	TObjectPtr<UTexture> BakedInScatteredLightTexture;
+
+	/**
+	 * The settings hash the baked textures were created with.
+	 */
+	UPROPERTY(VisibleAnywhere, Category = "Baking")
+	uint32 BakedSettingsHash = 0;
+
+	/**
+	 * @return Whether baked textures exist that match the current settings.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Atmosphere")
+	bool HasValidBakedTextures() const;
+
+	/**
+	 * @return The baked textures. Only valid if HasValidBakedTextures() returns true.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Atmosphere")
+	FAtmospherePrecomputedTextures GetBakedTextures() const;
+
+	/**
+	 * @return A hash of all settings that affect the precomputed textures.
+	 */
+	uint32 GetSettingsHash() const;
+};
@@ -1,16 +1,63 @@
 #pragma once
 
 #include "AtmosphereSettings.h"
+#include "AtmosphereDefinition.h"
 #include "SweetAtmosphereShaders/Public/Precompute/PrecomputeShader.h"
+#include "SweetAtmosphereShaders/Public/Precompute/PrecomputeScheduler.h"
+#include "Engine/AssetUserData.h"
 #include "Kismet/BlueprintAsyncActionBase.h"
 #include "AtmospherePrecompute.generated.h"
 
+/**
+ * Creates the shader parameters required for precomputing the given atmosphere.
+ *
+ * @param TextureSettings Texture settings.
+ * @param AtmosphereSettings Atmosphere settings.
+ * @return The precompute context.
+ */
+SWEETATMOSPHERE_API FPrecomputeContext CreatePrecomputeContext(
+	const FPrecomputedTextureSettings& TextureSettings,
+	const FAtmosphereSettings& AtmosphereSettings);
+
+/**
+ * Attached to in-scattered light textures precomputed with BakeHueShift,
+ * so their hue can be rotated to another hue shift, see UAtmosphereMaterialHelper::ResolveHueShift.
+ */
+UCLASS()
+class SWEETATMOSPHERE_API UAtmosphereHueShiftBakeData : public UAssetUserData
+{
+	GENERATED_BODY()
+public:
+	/**
+	 * The texture settings the texture was precomputed with.
+	 */
+	UPROPERTY()
+	FPrecomputedTextureSettings TextureSettings;
+
+	/**
+	 * The context the texture was precomputed with, including the baked hue shift.
+	 */
+	FPrecomputeContext Ctx;
+
+	/**
+	 * The precomputed texture whose hue was rotated into this texture, or null if this texture was precomputed itself.
+	 */
+	UPROPERTY()
+	TObjectPtr<UTexture> RotatedFrom;
+};
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnAtmospherePrecompute_AsyncExecutionCompleted,
 	FAtmospherePrecomputedTextures, Textures,
 	FAtmospherePrecomputeDebugTextures, DebugTextures);
 
 /**
  * Async Blueprint action running the atmosphere precomputation shader.
+ *
+ * Texture settings are scaled to the quality level at the time of the call, and the textures are delivered once.
+ * They aren't precomputed again when the quality level changes, register the atmosphere with
+ * UAtmosphereResidencySubsystem or use UProgressiveAtmospherePrecompute for that.
+ * Materials choose their filtering through the static ENABLE_TRILINEAR_FILTERING switch,
+ * which doesn't follow r.SweetAtmosphere.TrilinearFiltering.
  */
 UCLASS(BlueprintType)
 class SWEETATMOSPHERE_API UAtmospherePrecomputeAction : public UBlueprintAsyncActionBase
@@ -21,23 +68,31 @@ public:
 	 * Precomputes atmospheric scattering textures for
 	 * later use in a material graph or shader.
 	 *
-	 * @param TextureSettings Texture settings.
+	 * @param TextureSettings Texture settings, scaled to the current quality level by FAtmosphereScalability.
 	 * @param AtmosphereSettings Atmosphere settings.
-	 * @param Callback The callback to run on the game thread when precomputation has finished.
+	 * @param Callback The callback to run on the game thread when precomputation has finished,
+	 *                 with empty textures if it failed.
+	 * @param Owner If set, replaces any precomputation of the same owner that is still queued.
+	 * @param Priority Precomputations with a lower value are dispatched first.
+	 * @return A handle to cancel the precomputation through FAtmospherePrecomputeScheduler.
 	 */
-	static void PrecomputeAtmosphericScattering(
+	static FAtmospherePrecomputeJobHandle PrecomputeAtmosphericScattering(
 		FPrecomputedTextureSettings TextureSettings,
 		FAtmosphereSettings AtmosphereSettings,
-		bool GenerateDebugTextures, TFunction<void(FAtmospherePrecomputedTextures, FAtmospherePrecomputeDebugTextures)> Callback);
+		bool GenerateDebugTextures, TFunction<void(FAtmospherePrecomputedTextures, FAtmospherePrecomputeDebugTextures)> Callback,
+		const UObject* Owner = nullptr, float Priority = 0);
 
 	/**
 	 * Precomputes atmospheric scattering textures for
 	 * later use in a material graph or shader.
 	 *
 	 * @param WorldContextObject World Context Object.
-	 * @param TextureSettings Texture settings.
+	 * @param TextureSettings Texture settings, scaled to the current quality level by FAtmosphereScalability.
 	 * @param AtmosphereSettings Atmosphere settings.
 	 * @param GenerateDebugTextures Whether to read intermittent textures into FAtmospherePrecomputeDebugTextures.
+	 * @param Owner If set, cancels any pending precomputation of the same owner, e.g. the object editing the atmosphere,
+	 *              so that only the most recent settings are delivered. Canceled precomputations don't call back.
+	 * @param Priority Precomputations with a lower value are dispatched first.
 	 * @return Async Execution Task.
 	 */
 	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"), Category = "Atmospheric Scattering")
@@ -45,7 +100,30 @@ public:
 		const UObject* WorldContextObject,
 		const FPrecomputedTextureSettings& TextureSettings,
 		const FAtmosphereSettings& AtmosphereSettings,
-		bool GenerateDebugTextures);
+		bool GenerateDebugTextures,
+		const UObject* Owner = nullptr,
+		float Priority = 0);
+
+	/**
+	 * Loads the baked textures of an atmosphere definition,
+	 * or precomputes them if they haven't been baked or are outdated.
+	 * Definitions with BakeHueShift are always precomputed, since baked textures don't contain the hue shift.
+	 *
+	 * @param WorldContextObject World Context Object.
+	 * @param Definition The atmosphere definition.
+	 * @param GenerateDebugTextures Whether to read intermittent textures into FAtmospherePrecomputeDebugTextures.
+	 *                              Always precomputes the textures if set.
+	 * @param Owner If set, cancels any pending precomputation of the same owner, see PrecomputeAtmosphericScattering.
+	 * @param Priority Precomputations with a lower value are dispatched first.
+	 * @return Async Execution Task.
+	 */
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"), Category = "Atmospheric Scattering")
+	static UAtmospherePrecomputeAction* LoadOrPrecomputeAtmosphericScattering(
+		const UObject* WorldContextObject,
+		const UAtmosphereDefinition* Definition,
+		bool GenerateDebugTextures,
+		const UObject* Owner = nullptr,
+		float Priority = 0);
 
 	/**
 	 * Called with the result when shader execution is completed.
@@ -53,6 +131,12 @@ public:
 	UPROPERTY(BlueprintAssignable)
 	FOnAtmospherePrecompute_AsyncExecutionCompleted OnComplete;
 
+	/**
+	 * Called with empty textures if precomputation failed, e.g. because a shader isn't available.
+	 */
+	UPROPERTY(BlueprintAssignable)
+	FOnAtmospherePrecompute_AsyncExecutionCompleted OnFailed;
+
 	/**
 	 * Initializes this action. Must be called before Activate().
 	 * @param TextureSettings Texture settings.
@@ -63,11 +147,44 @@ public:
 
 	virtual void Activate() override;
 
+	/**
+	 * Cancels the precomputation. Neither OnComplete nor OnFailed are called afterwards.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Atmospheric Scattering")
+	void Cancel();
+
+	/**
+	 * @return The scheduler job of the precomputation, invalid if it hasn't been activated or didn't need to precompute.
+	 */
+	FAtmospherePrecomputeJobHandle GetJobHandle() const
+	{
+		return JobHandle;
+	}
+
 private:
 	FPrecomputedTextureSettings TextureSettings;
 	FPrecomputeContext AtmosphereGenerationSettings;
 
 	bool GenerateDebugTextures;
+
+	/**
+	 * Coalesces precomputations, see PrecomputeAtmosphericScattering.
+	 */
+	FObjectKey Owner;
+	float Priority = 0;
+
+	FAtmospherePrecomputeJobHandle JobHandle;
+
+	/**
+	 * Unregisters this action as the pending precomputation of its owner.
+	 */
+	void Finish();
+
+	/**
+	 * Baked textures to return instead of precomputing, if set.
+	 */
+	UPROPERTY()
+	FAtmospherePrecomputedTextures BakedTextures;
 };
 
 /**
@@ -91,6 +208,8 @@ public:
 
 	/**
 	 * Applies the atmosphere settings to the given material instance for rendering.
+	 * If the bound in-scattered light texture was precomputed with BakeHueShift and the hue shift changes,
+	 * its hue is rotated into a texture of this material instance, which is bound instead, see ResolveHueShift.
 	 *
 	 * @param MaterialInstance The target material instance.
 	 * @param Atmosphere The atmosphere settings.
@@ -106,4 +225,19 @@ public:
 	 */
 	UFUNCTION(BlueprintCallable, Category = "Atmosphere")
 	static void BindPrecomputedTextures(UMaterialInstanceDynamic* MaterialInstance, const FAtmospherePrecomputedTextures& PrecomputedTextures);
+
+	/**
+	 * Finds the in-scattered light texture a renderer should bind at a hue shift, and the hue shift it still has to apply.
+	 * If the texture was precomputed with BakeHueShift at another hue shift, its hue is rotated on the GPU
+	 * into a new texture, which holds the rotated texels before the next frame is rendered.
+	 * The precomputed texture is never modified, so it can be shared by renderers with different hue shifts.
+	 * Textures returned by an earlier call are rotated in place, so each of them belongs to a single renderer.
+	 * Must be called on the game thread.
+	 *
+	 * @param InScatteredLightTexture The bound in-scattered light texture.
+	 * @param HueShift The atmosphere's hue shift.
+	 * @param OutHueShift The hue shift to apply while rendering, 0 if it is baked into the returned texture.
+	 * @return The texture to bind, either InScatteredLightTexture or a texture its hue has been rotated into.
+	 */
+	static UTexture* ResolveHueShift(UTexture* InScatteredLightTexture, float HueShift, float& OutHueShift);
 };
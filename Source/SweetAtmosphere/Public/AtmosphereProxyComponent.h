@@ -0,0 +1,94 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralMeshComponent.h"
+#include "AtmosphereProxyComponent.generated.h"
+
+/**
+ * Renders the atmosphere material on a low-poly sphere circumscribing the atmosphere shell,
+ * so that no fragments outside the atmosphere are shaded.
+ *
+ * The sphere consists of an outward facing section, which is shown while all views are outside the sphere,
+ * and an inward facing section, which is shown while any view is inside the sphere.
+ * Only one section is ever shown, so additive and translucent materials never shade a pixel twice.
+ */
+UCLASS(ClassGroup = (Rendering), meta = (BlueprintSpawnableComponent))
+class SWEETATMOSPHERE_API UAtmosphereProxyComponent : public UProceduralMeshComponent
+{
+	GENERATED_BODY()
+public:
+	UAtmosphereProxyComponent(const FObjectInitializer& ObjectInitializer);
+
+	/**
+	 * The planet radius, in local space units of this component.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Atmosphere")
+	float PlanetRadius = 100;
+
+	/**
+	 * The atmosphere's size relative to the planet radius.
+	 * Should match FAtmosphereSettings::AtmosphereScale.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Atmosphere")
+	float AtmosphereScale = 0.2;
+
+	/**
+	 * The amount of times to subdivide the icosahedron the sphere is built from.
+	 * Every subdivision quadruples the triangle count, and tightens the fit around the shell.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Atmosphere", meta = (ClampMin = 0, ClampMax = 5))
+	int Subdivisions = 2;
+
+	/**
+	 * The atmosphere material to render.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Atmosphere")
+	TObjectPtr<UMaterialInterface> AtmosphereMaterial;
+
+	/**
+	 * Sets the size of the atmosphere shell and rebuilds the sphere.
+	 *
+	 * @param PlanetRadius The planet radius, in local space units of this component.
+	 * @param AtmosphereScale The atmosphere's size relative to the planet radius.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Atmosphere")
+	void SetShellSize(float PlanetRadius, float AtmosphereScale);
+
+	/**
+	 * Sets the atmosphere material to render on the sphere.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Atmosphere")
+	void SetAtmosphereMaterial(UMaterialInterface* Material);
+
+	virtual void OnRegister() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+	/**
+	 * The distance of the sphere's faces to its center.
+	 * Views closer to the center are inside of the sphere.
+	 */
+	float InnerRadius = 0;
+
+	/**
+	 * The distance of the sphere's vertices to its center.
+	 * Views further away from the center are outside of the sphere.
+	 */
+	float OuterRadius = 0;
+
+	/**
+	 * The plane of every face of the sphere, facing outwards, in local space.
+	 */
+	TArray<FPlane> FacePlanes;
+
+	/**
+	 * @return Whether a position in local space is inside the sphere.
+	 */
+	bool IsInside(const FVector& LocalPosition) const;
+
+	void RebuildMesh();
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AtmosphereSettings.h"
+#include "SweetAtmosphereShaders/Public/Precompute/PrecomputeShader.h"
+
+/**
+ * A ray to look up precomputed atmosphere values for.
+ */
+struct SWEETATMOSPHERE_API FAtmosphereQueryRay
+{
+	/**
+	 * The ray origin, in world space. Should lie inside the atmosphere.
+	 */
+	FVector Position = FVector::ZeroVector;
+
+	/**
+	 * The normalized ray direction.
+	 */
+	FVector3f Direction = FVector3f(0, 0, 1);
+
+	/**
+	 * The normalized direction of light rays coming from the sun.
+	 * Only used by in-scattered light lookups.
+	 */
+	FVector3f SunLightDir = FVector3f(0, 0, -1);
+};
+
+/**
+ * Keeps a float copy of precomputed texture data resident on the CPU,
+ * and samples it the same way atmospheres are rendered on the GPU (see GetInScatteredLight in InScatteredLight.ush).
+ *
+ * Samples are filtered (tri)linearly like with a linear clamped sampler: texel i is centered at (i + 0.5) / Size,
+ * and coordinates outside of the outermost texel centers are clamped to them.
+ * r.SweetAtmosphere.ValidateQuery compares the samples against hardware filtered samples of the same data.
+ * All functions are const and safe to call from any thread.
+ *
+ * The texture coordinates of four rays are computed at once, with one ray per vector lane.
+ * Batches of more than a few hundred rays are spread across worker threads.
+ */
+class SWEETATMOSPHERE_API FAtmosphereQuery
+{
+public:
+	/**
+	 * Copies the texture data.
+	 *
+	 * @param TextureData The texture data, e.g. returned by FAtmospherePrecomputeShaderDispatcher::LaunchTask.
+	 * @param TextureSettings The texture settings the data was precomputed with.
+	 * @param AtmosphereSettings The atmosphere settings the data was precomputed with.
+	 */
+	FAtmosphereQuery(
+		const FAtmospherePrecomputedTextureData& TextureData,
+		const FPrecomputedTextureSettings& TextureSettings,
+		const FAtmosphereSettings& AtmosphereSettings);
+
+	/**
+	 * Looks up the transmittance from every ray origin along the ray to the edge of the atmosphere.
+	 * Rays pointing towards the sun yield the sunlight color at the ray origin.
+	 *
+	 * @param PlanetOrigin The planet origin, in world space.
+	 * @param PlanetRadius The planet radius, in world space units.
+	 * @param Rays The rays to look up.
+	 * @param OutTransmittance Receives the transmittance of every ray. Must have the same size as Rays.
+	 */
+	void GetTransmittance(
+		const FVector& PlanetOrigin,
+		double PlanetRadius,
+		TConstArrayView<FAtmosphereQueryRay> Rays,
+		TArrayView<FLinearColor> OutTransmittance) const;
+
+	/**
+	 * Looks up the light in-scattered along every ray, scaled by the sun intensity and hue shifted.
+	 * Rays of an outer shell texture (see FPrecomputedTextureSettings::OuterShellOnly)
+	 * are assumed to start at the top of the atmosphere.
+	 *
+	 * @param PlanetOrigin The planet origin, in world space.
+	 * @param PlanetRadius The planet radius, in world space units.
+	 * @param Rays The rays to look up.
+	 * @param OutInScatteredLight Receives the in-scattered light of every ray. Must have the same size as Rays.
+	 */
+	void GetInScatteredLight(
+		const FVector& PlanetOrigin,
+		double PlanetRadius,
+		TConstArrayView<FAtmosphereQueryRay> Rays,
+		TArrayView<FLinearColor> OutInScatteredLight) const;
+
+	/**
+	 * Samples the transmittance texture at the given texture coordinates,
+	 * where X is the height and Y the encoded view angle.
+	 */
+	FLinearColor SampleTransmittanceTexture(const FVector2f& UV) const;
+
+	/**
+	 * Samples the in-scattered light texture at the given texture coordinates,
+	 * where X is the height, Y the encoded view angle and Z the encoded sun angle.
+	 * Outer shell textures ignore X. The result is neither scaled by the sun intensity nor hue shifted.
+	 */
+	FLinearColor SampleInScatteredLightTexture(const FVector3f& UVW) const;
+
+	/**
+	 * @return The CPU memory held by this query.
+	 */
+	SIZE_T GetAllocatedSize() const
+	{
+		return TransmittanceTexels.GetAllocatedSize() + InScatteredLightTexels.GetAllocatedSize();
+	}
+
+private:
+	FIntVector TransmittanceSize;
+	FIntVector InScatteredLightSize;
+
+	TArray<FVector4f> TransmittanceTexels;
+	TArray<FVector4f> InScatteredLightTexels;
+
+	float AtmosphereScale;
+	float SunIntensity;
+
+	/**
+	 * The hue shift left to apply after sampling, in radians. 0 if it was baked into the texture data.
+	 */
+	float HueShift;
+};
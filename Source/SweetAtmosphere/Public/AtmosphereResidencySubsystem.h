@@ -0,0 +1,239 @@
+#pragma once
+
+#include "AtmospherePrecompute.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AtmosphereResidencySubsystem.generated.h"
+
+/**
+ * Identifies an atmosphere registered with UAtmosphereResidencySubsystem.
+ */
+USTRUCT(BlueprintType)
+struct SWEETATMOSPHERE_API FAtmosphereResidencyHandle
+{
+	GENERATED_BODY()
+
+	uint64 Id = 0;
+
+	bool IsValid() const
+	{
+		return Id != 0;
+	}
+};
+
+DECLARE_DYNAMIC_DELEGATE_OneParam(FOnAtmosphereResidentTexturesChanged, const FAtmospherePrecomputedTextures&, Textures);
+
+/**
+ * An atmosphere tracked by UAtmosphereResidencySubsystem.
+ */
+USTRUCT()
+struct FAtmosphereResidencyEntry
+{
+	GENERATED_BODY()
+
+	uint64 Id = 0;
+
+	/**
+	 * The component at the planet origin. Also coalesces precomputations of the same atmosphere.
+	 */
+	TWeakObjectPtr<USceneComponent> Anchor;
+
+	float PlanetRadius = 0;
+	FPrecomputedTextureSettings TextureSettings;
+	FAtmosphereSettings AtmosphereSettings;
+
+	/**
+	 * Called with the resident textures whenever they have been precomputed at another quality tier,
+	 * or empty textures once they have been evicted.
+	 */
+	TFunction<void(const FAtmospherePrecomputedTextures&)> OnTexturesChanged;
+
+	/**
+	 * The resident textures, empty if evicted.
+	 */
+	UPROPERTY()
+	FAtmospherePrecomputedTextures Textures;
+
+	/**
+	 * The quality tier of the resident textures, see UAtmosphereResidencySubsystem::NumQualityTiers.
+	 */
+	int32 Tier = 0;
+
+	/**
+	 * The precomputation regenerating the textures, if any.
+	 */
+	FAtmospherePrecomputeJobHandle PendingJob;
+
+	/**
+	 * The quality tier of the pending precomputation.
+	 */
+	int32 PendingTier = 0;
+
+	/**
+	 * Whether the last precomputation failed. The atmosphere isn't precomputed again until the quality level changes.
+	 */
+	bool PrecomputeFailed = false;
+
+	/**
+	 * The estimated GPU memory of the textures at each quality tier computed so far,
+	 * see UAtmosphereResidencySubsystem::GetNumBytes.
+	 */
+	TArray<uint64> NumBytesPerTier;
+
+	/**
+	 * The importance of the atmosphere as of the last update, see UAtmosphereResidencySubsystem.
+	 */
+	float Importance = 0;
+};
+
+/**
+ * Keeps the precomputed textures of many atmospheres within a GPU memory budget.
+ *
+ * Every registered atmosphere is ranked by its importance, the angular radius of its atmosphere
+ * as seen from the closest view, normalized so that 1 means the view is inside the atmosphere.
+ * As many atmospheres as possible are kept resident at their lowest quality tier, most important first,
+ * and the remaining budget upgrades them in the same order. The least important atmospheres are therefore
+ * downgraded first, and only evicted if they don't fit even at the lowest tier. Evicted atmospheres are notified
+ * with empty textures, so that they can fall back to a cheap representation.
+ *
+ * Evicted and downgraded atmospheres are precomputed again in the background as soon as they become important enough,
+ * which happens before they get large on screen, since MinImportance is usually tiny.
+ * They keep their current textures until the new ones are ready.
+ *
+ * When the quality level of FAtmosphereScalability changes, all resident atmospheres are precomputed again
+ * in the background and keep their current textures until the new ones are ready.
+ */
+UCLASS()
+class SWEETATMOSPHERE_API UAtmosphereResidencySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	/**
+	 * The GPU memory all resident atmosphere textures may occupy, in bytes.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Atmosphere")
+	int64 MemoryBudget = 512ll * 1024 * 1024;
+
+	/**
+	 * The importance an atmosphere must exceed to be made resident.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Atmosphere")
+	float MinImportance = 0.005f;
+
+	/**
+	 * Resident atmospheres are only evicted for being unimportant once their importance
+	 * falls below MinImportance times this factor, to avoid precomputing them again and again.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Atmosphere")
+	float EvictionHysteresis = 0.5f;
+
+	/**
+	 * The amount of quality tiers atmospheres are precomputed at. Tier 0 uses the registered texture settings,
+	 * every further tier halves all texture resolutions. 1 disables downgrading, so atmospheres are only evicted.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Atmosphere", meta = (ClampMin = 1))
+	int32 NumQualityTiers = 3;
+
+	/**
+	 * Starts tracking an atmosphere. Its textures are precomputed once it is important enough.
+	 *
+	 * @param Anchor The component at the planet origin.
+	 * @param PlanetRadius The planet radius, in world space units.
+	 * @param TextureSettings The texture settings to precompute with.
+	 * @param AtmosphereSettings The atmosphere settings to precompute with.
+	 * @param OnTexturesChanged Called on the game thread with the resident textures whenever they have been
+	 *                          precomputed at another quality tier, or empty textures once they have been evicted.
+	 * @return A handle to unregister the atmosphere.
+	 */
+	FAtmosphereResidencyHandle Register(
+		USceneComponent* Anchor,
+		float PlanetRadius,
+		const FPrecomputedTextureSettings& TextureSettings,
+		const FAtmosphereSettings& AtmosphereSettings,
+		TFunction<void(const FAtmospherePrecomputedTextures&)> OnTexturesChanged);
+
+	/**
+	 * Starts tracking an atmosphere. Its textures are precomputed once it is important enough.
+	 *
+	 * @param Anchor The component at the planet origin.
+	 * @param PlanetRadius The planet radius, in world space units.
+	 * @param TextureSettings The texture settings to precompute with.
+	 * @param AtmosphereSettings The atmosphere settings to precompute with.
+	 * @param OnTexturesChanged Called with the resident textures whenever they have been
+	 *                          precomputed at another quality tier, or empty textures once they have been evicted.
+	 * @return A handle to unregister the atmosphere.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Atmosphere", meta = (DisplayName = "Register"))
+	FAtmosphereResidencyHandle RegisterAtmosphere(
+		USceneComponent* Anchor,
+		float PlanetRadius,
+		const FPrecomputedTextureSettings& TextureSettings,
+		const FAtmosphereSettings& AtmosphereSettings,
+		FOnAtmosphereResidentTexturesChanged OnTexturesChanged);
+
+	/**
+	 * Stops tracking an atmosphere and releases its textures.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Atmosphere")
+	void Unregister(FAtmosphereResidencyHandle Handle);
+
+	/**
+	 * @return The estimated GPU memory of all resident textures, in bytes.
+	 */
+	uint64 GetResidentBytes() const;
+
+	/**
+	 * @return The estimated GPU memory of textures precomputed with exactly the given settings, in bytes.
+	 *         Safe to call from any thread.
+	 */
+	static uint64 EstimateBytes(const FPrecomputedTextureSettings& TextureSettings);
+
+	/**
+	 * @return The estimated GPU memory of textures precomputed with the given settings
+	 *         at the current quality level, in bytes. Must be called on the game thread.
+	 */
+	static uint64 EstimateResidentBytes(const FPrecomputedTextureSettings& TextureSettings);
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual bool IsTickableInEditor() const override { return true; }
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+private:
+	UPROPERTY()
+	TArray<FAtmosphereResidencyEntry> Entries;
+
+	uint64 NextId = 1;
+
+	FDelegateHandle ScalabilityChangedHandle;
+
+	/**
+	 * Updates the importance of every atmosphere for the given view locations.
+	 */
+	void UpdateImportance(const TArray<FVector>& ViewLocations);
+
+	/**
+	 * @return The texture settings of a quality tier, see NumQualityTiers.
+	 */
+	static FPrecomputedTextureSettings GetTierSettings(const FPrecomputedTextureSettings& TextureSettings, int32 Tier);
+
+	/**
+	 * @return The estimated GPU memory of an atmosphere's textures at a quality tier and the current quality level.
+	 */
+	static uint64 GetNumBytes(FAtmosphereResidencyEntry& Entry, int32 Tier);
+
+	/**
+	 * Precomputes the textures of an atmosphere at a quality tier, keeping its current textures until they are ready.
+	 */
+	void MakeResident(FAtmosphereResidencyEntry& Entry, int32 Tier);
+	void Evict(FAtmosphereResidencyEntry& Entry);
+
+	void OnTexturesPrecomputed(uint64 Id, int32 Tier, const FAtmospherePrecomputedTextures& Textures);
+
+	/**
+	 * Precomputes all resident atmospheres again at the new quality level.
+	 */
+	void OnScalabilityChanged();
+};
@@ -9,30 +9,44 @@ class SWEETATMOSPHERE_API UDebugTextureHelper : public UObject
 public:
 	/**
 	 * Writes a 2D or Volume texture to EXR file(s).
+	 * Files are encoded and written asynchronously.
 	 *
 	 * @param Texture The input texture.
-	 * @param FilepathNoExtension The output filename including path without the ".png" extension.
+	 * @param FilepathNoExtension The output filename including path without the ".exr" extension.
 	 */
 	UFUNCTION(BlueprintCallable, Category = "Texture")
 	static void SaveTextureToEXR(UTexture* Texture, const FString& FilepathNoExtension);
 
 	/**
 	 * Writes a 2D texture to an EXR file.
+	 * The file is encoded and written asynchronously.
 	 * Texture pixel format must be PF_FloatRGBA.
 	 *
 	 * @param Texture The input texture.
-	 * @param FilepathNoExtension The output filename including path without the ".png" extension.
+	 * @param FilepathNoExtension The output filename including path without the ".exr" extension.
 	 */
 	UFUNCTION(BlueprintCallable, Category = "Texture")
 	static void SaveTexture2DToEXR(UTexture2D* Texture, const FString& FilepathNoExtension);
 
 	/**
 	 * Writes a volume texture to individual EXR files for each Z layer.
+	 * Layers are encoded and written in parallel on worker threads.
 	 * Texture pixel format must be PF_FloatRGBA.
 	 *
 	 * @param VolumeTexture The input texture.
-	 * @param FilepathNoExtension The output filename including path without the ".png" extension.
+	 * @param FilepathNoExtension The output filename including path without the ".exr" extension.
 	 */
 	UFUNCTION(BlueprintCallable, Category = "Texture")
 	static void SaveVolumeTextureToEXR(UVolumeTexture* VolumeTexture, const FString& FilepathNoExtension);
-};
\ No newline at end of file
+
+	/**
+	 * Writes a volume texture to a single DDS file.
+	 * The file is written asynchronously.
+	 * Texture pixel format must be PF_FloatRGBA.
+	 *
+	 * @param VolumeTexture The input texture.
+	 * @param FilepathNoExtension The output filename including path without the ".dds" extension.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Texture")
+	static void SaveVolumeTextureToDDS(UVolumeTexture* VolumeTexture, const FString& FilepathNoExtension);
+};
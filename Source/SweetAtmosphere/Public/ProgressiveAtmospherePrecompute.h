@@ -0,0 +1,103 @@
+#pragma once
+
+#include "AtmospherePrecompute.h"
+#include "Containers/Ticker.h"
+#include "ProgressiveAtmospherePrecompute.generated.h"
+
+/**
+ * Keeps a material instance's atmosphere textures up to date while its settings are being edited.
+ * Every update first precomputes low-resolution preview textures, which are bound right away.
+ * Once the settings haven't changed for RefinementDelay seconds,
+ * the textures are precomputed again using the final texture settings.
+ * The final textures are also precomputed again whenever the quality level of FAtmosphereScalability changes.
+ */
+UCLASS(BlueprintType)
+class SWEETATMOSPHERE_API UProgressiveAtmospherePrecompute : public UObject
+{
+	GENERATED_BODY()
+public:
+	UProgressiveAtmospherePrecompute();
+
+	/**
+	 * Creates a progressive precomputation for the given material instance.
+	 *
+	 * @param MaterialInstance The material instance to bind the textures to.
+	 * @param TextureSettings The final texture settings.
+	 * @return The progressive precomputation. Call Update() to start precomputing.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Atmospheric Scattering")
+	static UProgressiveAtmospherePrecompute* CreateProgressivePrecompute(
+		UMaterialInstanceDynamic* MaterialInstance,
+		const FPrecomputedTextureSettings& TextureSettings);
+
+	/**
+	 * Precomputes preview textures for the given settings
+	 * and schedules the refinement to the final texture settings.
+	 *
+	 * @param AtmosphereSettings The new atmosphere settings.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Atmospheric Scattering")
+	void Update(const FAtmosphereSettings& AtmosphereSettings);
+
+	/**
+	 * The material instance the textures are bound to.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	TObjectPtr<UMaterialInstanceDynamic> MaterialInstance;
+
+	/**
+	 * The final texture settings.
+	 */
+	UPROPERTY(BlueprintReadWrite)
+	FPrecomputedTextureSettings TextureSettings;
+
+	/**
+	 * The texture resolutions and sample steps to precompute previews with.
+	 * All other settings are taken from TextureSettings, so previews match the final textures' layout and format.
+	 */
+	UPROPERTY(BlueprintReadWrite)
+	FPrecomputedTextureSettings PreviewTextureSettings;
+
+	/**
+	 * The time in seconds the settings must stay unchanged before precomputing the final textures.
+	 */
+	UPROPERTY(BlueprintReadWrite)
+	float RefinementDelay = 0.5f;
+
+	/**
+	 * The textures currently bound to the material instance.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	FAtmospherePrecomputedTextures Textures;
+
+	/**
+	 * Called when the final textures have been bound.
+	 */
+	UPROPERTY(BlueprintAssignable)
+	FOnAtmospherePrecompute_AsyncExecutionCompleted OnRefined;
+
+	virtual void BeginDestroy() override;
+
+private:
+	FAtmosphereSettings AtmosphereSettings;
+
+	/**
+	 * Incremented on every update to discard results for outdated settings.
+	 */
+	uint32 Generation = 0;
+
+	/**
+	 * Whether the final textures for the current generation have been bound.
+	 */
+	bool IsRefined = false;
+
+	FTSTicker::FDelegateHandle RefinementTickerHandle;
+
+	FDelegateHandle ScalabilityChangedHandle;
+
+	void Precompute(const FPrecomputedTextureSettings& Settings, bool IsPreview);
+
+	bool Refine(float DeltaTime);
+
+	void OnScalabilityChanged();
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AtmosphereComponent.h"
+#include "ReducedResolutionAtmosphereComponent.generated.h"
+
+/**
+ * Renders an atmosphere around this component's location without a material,
+ * at a reduced resolution controlled by r.SweetAtmosphere.ResolutionDivisor.
+ *
+ * The atmosphere is rendered once per view after the base pass, upsampled using the scene depth
+ * and added to the scene color before translucency is rendered on top of it,
+ * and before temporal anti-aliasing accumulates it over time.
+ * Only the in-scattered light is added, so the scene behind the atmosphere is not attenuated.
+ * Overlapping atmospheres are composited front to back, so the light of farther atmospheres is attenuated by closer ones.
+ * Like every UAtmosphereComponent, the atmosphere also provides aerial perspective to a UAerialPerspectiveVolumeComponent.
+ */
+UCLASS(ClassGroup = (Rendering), meta = (BlueprintSpawnableComponent))
+class SWEETATMOSPHERE_API UReducedResolutionAtmosphereComponent : public UAtmosphereComponent
+{
+	GENERATED_BODY()
+public:
+	/**
+	 * Whether to render the atmosphere at a reduced resolution.
+	 * If disabled, the atmosphere only provides aerial perspective, like a UAtmosphereComponent.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Atmosphere")
+	bool RenderAtReducedResolution = true;
+
+protected:
+	virtual bool ShouldRenderAtReducedResolution() const override;
+};
@@ -5,8 +5,17 @@
 
 // include all other headers that expose functions
 // ReSharper disable CppUnusedIncludeDirective
+#include "AerialPerspectiveVolumeComponent.h"
+#include "AtmosphereAutoTuner.h"
+#include "AtmosphereComponent.h"
+#include "AtmosphereDefinition.h"
 #include "AtmospherePrecompute.h"
+#include "AtmosphereProxyComponent.h"
+#include "AtmosphereQuery.h"
+#include "AtmosphereResidencySubsystem.h"
 #include "DebugTextureHelper.h"
+#include "ProgressiveAtmospherePrecompute.h"
+#include "ReducedResolutionAtmosphereComponent.h"
 // ReSharper restore CppUnusedIncludeDirective
 
 class FSweetAtmosphere : public IModuleInterface
@@ -11,7 +11,7 @@ public class SweetAtmosphere : ModuleRules
 		PublicDependencyModuleNames.AddRange(
 			new[]
 			{
-				"Core", "Engine", "SweetAtmosphereShaders"
+				"Core", "Engine", "ProceduralMeshComponent", "SweetAtmosphereShaders"
 			}
 		);
 
@@ -23,6 +23,8 @@ public class SweetAtmosphere : ModuleRules
 				"Slate",
 				"SlateCore",
 				"ImageWriteQueue",
+				"RenderCore",
+				"RHI",
 			}
 		);
 	}
@@ -0,0 +1,212 @@
+#include "BakeAtmosphereTexturesCommandlet.h"
+
+#include "AtmosphereDefinition.h"
+#include "AtmospherePrecompute.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "Engine/VolumeTexture.h"
+#include "RenderingThread.h"
+#include "Misc/PackageName.h"
+#include "UObject/SavePackage.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogBakeAtmosphereTextures, Log, All);
+
+UBakeAtmosphereTexturesCommandlet::UBakeAtmosphereTexturesCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+/**
+ * Creates or updates a texture asset in the same directory as the atmosphere definition.
+ *
+ * @param Definition The atmosphere definition the texture belongs to.
+ * @param Suffix The suffix to append to the definition's name.
+ * @param TextureData The precomputed texture data.
+ * @return The texture asset.
+ */
+template <typename TTexture>
+static TTexture* CreateTextureAsset(const UAtmosphereDefinition* Definition, const FString& Suffix, const FTextureData& TextureData)
+{
+	check(TextureData.PixelFormat == PF_FloatRGBA);
+
+	const FString AssetName = Definition->GetName() + TEXT("_") + Suffix;
+	const FString PackageName = FPackageName::GetLongPackagePath(Definition->GetPackage()->GetName()) / AssetName;
+
+	UPackage* Package = FPackageName::DoesPackageExist(PackageName)
+		? LoadPackage(nullptr, *PackageName, LOAD_None)
+		: CreatePackage(*PackageName);
+	check(Package);
+
+	TTexture* Texture = FindObject<TTexture>(Package, *AssetName);
+	const bool IsNew = !Texture;
+	if (IsNew)
+	{
+		Texture = NewObject<TTexture>(Package, *AssetName, RF_Public | RF_Standalone);
+	}
+
+	Texture->PreEditChange(nullptr);
+	Texture->Source.Init(TextureData.Size.X, TextureData.Size.Y, FMath::Max(TextureData.Size.Z, 1), 1,
+		TSF_RGBA16F, TextureData.Data.GetData());
+	Texture->SRGB = false;
+	Texture->CompressionSettings = Definition->CompressionSettings;
+	Texture->MipGenSettings = Definition->MipGenSettings;
+	Texture->PostEditChange();
+
+	if (IsNew)
+	{
+		FAssetRegistryModule::AssetCreated(Texture);
+	}
+	Package->MarkPackageDirty();
+	return Texture;
+}
+
+static bool SaveAsset(UObject* Asset)
+{
+	UPackage* Package = Asset->GetPackage();
+	const FString Filename = FPackageName::LongPackageNameToFilename(
+		Package->GetName(), FPackageName::GetAssetPackageExtension());
+
+	FSavePackageArgs SaveArgs;
+	SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+	if (!UPackage::SavePackage(Package, Asset, *Filename, SaveArgs))
+	{
+		UE_LOG(LogBakeAtmosphereTextures, Error, TEXT("Failed to save %s"), *Filename);
+		return false;
+	}
+	return true;
+}
+
+int32 UBakeAtmosphereTexturesCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamVals;
+	ParseCommandLine(*Params, Tokens, Switches, ParamVals);
+
+	const bool Force = Switches.Contains(TEXT("Force"));
+	const FString* TimeoutParam = ParamVals.Find(TEXT("Timeout"));
+	const double Timeout = TimeoutParam ? FCString::Atod(**TimeoutParam) : 600;
+
+	// discover all atmosphere definitions
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	AssetRegistry.SearchAllAssets(true);
+
+	FARFilter Filter;
+	Filter.ClassPaths.Add(UAtmosphereDefinition::StaticClass()->GetClassPathName());
+	Filter.bRecursiveClasses = true;
+	Filter.bRecursivePaths = true;
+	if (const FString* Path = ParamVals.Find(TEXT("Path")))
+	{
+		Filter.PackagePaths.Add(FName(*Path));
+	}
+
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssets(Filter, Assets);
+
+	// dispatch all precomputations at once so they can run in parallel on the GPU
+	TArray<UAtmosphereDefinition*> Definitions;
+	TArray<TSharedRef<TOptional<FAtmospherePrecomputedTextureData>>> Results;
+	for (const auto& Asset : Assets)
+	{
+		auto* Definition = Cast<UAtmosphereDefinition>(Asset.GetAsset());
+		if (!Definition || !Definition->BakeTextures)
+		{
+			continue;
+		}
+		if (!Force && Definition->HasValidBakedTextures())
+		{
+			UE_LOG(LogBakeAtmosphereTextures, Display, TEXT("%s is up to date"), *Definition->GetPathName());
+			continue;
+		}
+
+		// compressed textures can't hold the negative channels of rotated hues, so leave the hue shift to the material.
+		// LoadOrPrecomputeAtmosphericScattering doesn't use these textures for definitions that bake it.
+		auto TextureSettings = Definition->TextureSettings;
+		TextureSettings.BakeHueShift = false;
+
+		auto Result = MakeShared<TOptional<FAtmospherePrecomputedTextureData>>();
+		FAtmospherePrecomputeShaderDispatcher::Dispatch(
+			TextureSettings,
+			CreatePrecomputeContext(TextureSettings, Definition->AtmosphereSettings),
+			false,
+			[Result](FAtmospherePrecomputedTextureData TextureData, FAtmospherePrecomputedDebugTextureData) {
+				*Result = MoveTemp(TextureData);
+			});
+
+		Definitions.Add(Definition);
+		Results.Add(Result);
+	}
+
+	// the dispatcher delivers its results on the game thread, so pump it until all are done.
+	// without a rendering thread, render commands run inline and readbacks are polled on the game thread too.
+	if (!GIsThreadedRendering)
+	{
+		UE_LOG(LogBakeAtmosphereTextures, Display, TEXT("No rendering thread, polling readbacks on the game thread"));
+	}
+	auto IsPending = [](const TSharedRef<TOptional<FAtmospherePrecomputedTextureData>>& Result) {
+		return !Result->IsSet();
+	};
+	const double StartTime = FPlatformTime::Seconds();
+	while (Results.ContainsByPredicate(IsPending))
+	{
+		if (FPlatformTime::Seconds() - StartTime > Timeout)
+		{
+			UE_LOG(LogBakeAtmosphereTextures, Error, TEXT("Timed out after %.0f seconds"), Timeout);
+			break;
+		}
+
+		FlushRenderingCommands();
+		FTaskGraphInterface::Get().ProcessThreadUntilIdle(ENamedThreads::GameThread);
+		FPlatformProcess::Sleep(0.01f);
+	}
+
+	int32 NumFailed = 0;
+	for (int32 i = 0; i < Definitions.Num(); i++)
+	{
+		auto* Definition = Definitions[i];
+		if (!Results[i]->IsSet())
+		{
+			UE_LOG(LogBakeAtmosphereTextures, Error, TEXT("Still precomputing %s"), *Definition->GetPathName());
+			NumFailed++;
+			continue;
+		}
+
+		const auto& TextureData = Results[i]->GetValue();
+		if (!TextureData.Succeeded)
+		{
+			UE_LOG(LogBakeAtmosphereTextures, Error, TEXT("Failed to precompute %s"), *Definition->GetPathName());
+			NumFailed++;
+			continue;
+		}
+
+		Definition->Modify();
+		Definition->BakedTransmittanceTexture = CreateTextureAsset<UTexture2D>(
+			Definition, TEXT("Transmittance"), TextureData.TransmittanceTextureData);
+		if (TextureData.InScatteredLightTextureData.IsVolumeTexture())
+		{
+			Definition->BakedInScatteredLightTexture = CreateTextureAsset<UVolumeTexture>(
+				Definition, TEXT("InScatteredLight"), TextureData.InScatteredLightTextureData);
+		}
+		else
+		{
+			Definition->BakedInScatteredLightTexture = CreateTextureAsset<UTexture2D>(
+				Definition, TEXT("InScatteredLight"), TextureData.InScatteredLightTextureData);
+		}
+		Definition->BakedSettingsHash = Definition->GetSettingsHash();
+
+		const bool Saved = SaveAsset(Definition->BakedTransmittanceTexture)
+			&& SaveAsset(Definition->BakedInScatteredLightTexture)
+			&& SaveAsset(Definition);
+		if (!Saved)
+		{
+			NumFailed++;
+			continue;
+		}
+
+		UE_LOG(LogBakeAtmosphereTextures, Display, TEXT("Baked %s"), *Definition->GetPathName());
+	}
+
+	return NumFailed == 0 ? 0 : 1;
+}
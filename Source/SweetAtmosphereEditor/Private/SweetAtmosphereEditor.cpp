@@ -0,0 +1,11 @@
+#include "../Public/SweetAtmosphereEditor.h"
+
+void FSweetAtmosphereEditor::StartupModule()
+{
+}
+
+void FSweetAtmosphereEditor::ShutdownModule()
+{
+}
+
+IMPLEMENT_MODULE(FSweetAtmosphereEditor, SweetAtmosphereEditor)
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "BakeAtmosphereTexturesCommandlet.generated.h"
+
+/**
+ * Precomputes the textures of all UAtmosphereDefinition assets
+ * and saves them as texture assets next to their definition,
+ * so they can be compressed by the cooker and loaded at runtime
+ * instead of being precomputed on the player's GPU.
+ *
+ * Usage: UnrealEditor-Cmd.exe Project.uproject -run=BakeAtmosphereTextures [-Path=/Game/Planets] [-Force] [-Timeout=600]
+ * Requires a GPU, so it can't be run with -nullrhi.
+ * Fails if not all atmospheres have been precomputed within Timeout seconds.
+ */
+UCLASS()
+class UBakeAtmosphereTexturesCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UBakeAtmosphereTexturesCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
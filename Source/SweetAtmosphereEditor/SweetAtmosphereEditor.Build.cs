@@ -0,0 +1,26 @@
+using UnrealBuildTool;
+
+public class SweetAtmosphereEditor : ModuleRules
+{
+	public SweetAtmosphereEditor(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(
+			new[]
+			{
+				"Core", "Engine", "SweetAtmosphere", "SweetAtmosphereShaders"
+			}
+		);
+
+		PrivateDependencyModuleNames.AddRange(
+			new[]
+			{
+				"CoreUObject",
+				"AssetRegistry",
+				"RenderCore",
+				"UnrealEd",
+			}
+		);
+	}
+}
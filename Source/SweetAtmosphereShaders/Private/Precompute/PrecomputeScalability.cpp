@@ -0,0 +1,135 @@
+#include "Precompute/PrecomputeScalability.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/ConfigCacheIni.h"
+#include "Misc/FileHelper.h"
+
+static TAutoConsoleVariable<float> CVarTextureResolutionScale(
+	TEXT("r.SweetAtmosphere.TextureResolutionScale"),
+	1.0f,
+	TEXT("Scales the resolution of all precomputed atmosphere textures."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarSampleStepScale(
+	TEXT("r.SweetAtmosphere.SampleStepScale"),
+	1.0f,
+	TEXT("Scales the amount of ray marching steps used to precompute atmosphere textures."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarCompactTextureFormat(
+	TEXT("r.SweetAtmosphere.CompactTextureFormat"),
+	0,
+	TEXT("Whether to store precomputed atmosphere textures as PF_FloatR11G11B10 instead of PF_FloatRGBA.\n")
+	TEXT(" 0: full precision (default)\n")
+	TEXT(" 1: half the memory, with visible banding in dark gradients"),
+	ECVF_Scalability);
+
+/**
+ * The smallest amount of texels along any texture axis and of ray marching steps after scaling.
+ */
+static constexpr int32 MinScaledValue = 4;
+
+/**
+ * The console variable values as of the last change notification.
+ */
+static float AppliedTextureResolutionScale = 1.0f;
+static float AppliedSampleStepScale = 1.0f;
+static int32 AppliedCompactTextureFormat = 0;
+
+static int32 Scale(const int32 Value, const float Factor)
+{
+	return FMath::Max(FMath::Min(Value, MinScaledValue), FMath::RoundToInt(Value * Factor));
+}
+
+FPrecomputedTextureSettings FAtmosphereScalability::Apply(const FPrecomputedTextureSettings& TextureSettings)
+{
+	const float ResolutionScale = FMath::Clamp(CVarTextureResolutionScale.GetValueOnGameThread(), 0.0f, 1.0f);
+	const float StepScale = FMath::Clamp(CVarSampleStepScale.GetValueOnGameThread(), 0.0f, 1.0f);
+
+	FPrecomputedTextureSettings Scaled = TextureSettings;
+	Scaled.TransmittanceTextureWidth = Scale(TextureSettings.TransmittanceTextureWidth, ResolutionScale);
+	Scaled.TransmittanceTextureHeight = Scale(TextureSettings.TransmittanceTextureHeight, ResolutionScale);
+	Scaled.InScatteredLightTextureSize = Scale(TextureSettings.InScatteredLightTextureSize, ResolutionScale);
+
+	// axes left at 0 keep following InScatteredLightTextureSize
+	const FIntVector& Dimensions = TextureSettings.InScatteredLightTextureDimensions;
+	Scaled.InScatteredLightTextureDimensions = FIntVector(
+		Dimensions.X > 0 ? Scale(Dimensions.X, ResolutionScale) : 0,
+		Dimensions.Y > 0 ? Scale(Dimensions.Y, ResolutionScale) : 0,
+		Dimensions.Z > 0 ? Scale(Dimensions.Z, ResolutionScale) : 0);
+
+	Scaled.TransmittanceSampleSteps = Scale(TextureSettings.TransmittanceSampleSteps, StepScale);
+	Scaled.InScatteredLightSampleSteps = Scale(TextureSettings.InScatteredLightSampleSteps, StepScale);
+
+	Scaled.CompactTextureFormat |= CVarCompactTextureFormat.GetValueOnGameThread() != 0;
+	return Scaled;
+}
+
+void FAtmosphereScalability::RegisterQualityLevels()
+{
+	const FString PluginScalabilityIni = FPaths::Combine(
+		IPluginManager::Get().FindPlugin(TEXT("SweetAtmosphere"))->GetBaseDir(), TEXT("Config/DefaultScalability.ini"));
+	FConfigFile* ScalabilityConfig = GConfig->FindConfigFile(GScalabilityIni);
+
+	TArray<FString> Lines;
+	if (!ScalabilityConfig || !FFileHelper::LoadFileToStringArray(Lines, *PluginScalabilityIni))
+	{
+		UE_LOG(LogConfig, Warning, TEXT("Failed to register the SweetAtmosphere scalability levels from %s"), *PluginScalabilityIni);
+		return;
+	}
+
+	// the engine only merges a plugin's own config file, so add the plugin's quality levels to the scalability config.
+	// values set by the project's DefaultScalability.ini take precedence.
+	FString Section;
+	for (const FString& Line : Lines)
+	{
+		const FString Trimmed = Line.TrimStartAndEnd();
+		FString Key, Value;
+		if (Trimmed.StartsWith(TEXT("[")) && Trimmed.EndsWith(TEXT("]")))
+		{
+			Section = Trimmed.Mid(1, Trimmed.Len() - 2);
+		}
+		else if (!Section.IsEmpty() && !Trimmed.StartsWith(TEXT(";")) && Trimmed.Split(TEXT("="), &Key, &Value))
+		{
+			FString ExistingValue;
+			if (!ScalabilityConfig->GetString(*Section, *Key, ExistingValue))
+			{
+				ScalabilityConfig->SetString(*Section, *Key, *Value);
+			}
+		}
+	}
+
+	// the added values are defaults, they must not be saved as user settings
+	ScalabilityConfig->Dirty = false;
+}
+
+FSimpleMulticastDelegate& FAtmosphereScalability::OnChanged()
+{
+	static FSimpleMulticastDelegate Delegate;
+	return Delegate;
+}
+
+/**
+ * Notifies listeners once after a scalability level change has set all console variables,
+ * and only if any of them actually changed.
+ */
+static void OnConsoleVariablesChanged()
+{
+	const float TextureResolutionScale = CVarTextureResolutionScale.GetValueOnGameThread();
+	const float SampleStepScale = CVarSampleStepScale.GetValueOnGameThread();
+	const int32 CompactTextureFormat = CVarCompactTextureFormat.GetValueOnGameThread();
+	if (TextureResolutionScale == AppliedTextureResolutionScale
+		&& SampleStepScale == AppliedSampleStepScale
+		&& CompactTextureFormat == AppliedCompactTextureFormat)
+	{
+		return;
+	}
+
+	AppliedTextureResolutionScale = TextureResolutionScale;
+	AppliedSampleStepScale = SampleStepScale;
+	AppliedCompactTextureFormat = CompactTextureFormat;
+	FAtmosphereScalability::OnChanged().Broadcast();
+}
+
+static FAutoConsoleVariableSink CVarSink(FConsoleCommandDelegate::CreateStatic(&OnConsoleVariablesChanged));
@@ -0,0 +1,166 @@
+#include "Precompute/PrecomputeScheduler.h"
+
+FAtmospherePrecomputeScheduler& FAtmospherePrecomputeScheduler::Get()
+{
+	static FAtmospherePrecomputeScheduler Instance;
+	return Instance;
+}
+
+FAtmospherePrecomputeJobHandle FAtmospherePrecomputeScheduler::Enqueue(
+	const FObjectKey Owner,
+	const FPrecomputedTextureSettings& TextureSettings,
+	const FPrecomputeContext& Ctx,
+	const bool GenerateDebugTextures,
+	const float Priority,
+	FCallback Callback)
+{
+	check(IsInGameThread());
+
+	if (Owner != FObjectKey())
+	{
+		// a newer request makes any queued request of the same owner obsolete
+		QueuedJobs.RemoveAll([Owner](const FJob& Job) {
+			return Job.Owner == Owner;
+		});
+	}
+
+	FJob Job;
+	Job.Id = NextJobId++;
+	Job.Owner = Owner;
+	Job.TextureSettings = TextureSettings;
+	Job.Ctx = Ctx;
+	Job.GenerateDebugTextures = GenerateDebugTextures;
+	Job.Priority = Priority;
+	Job.NumBytes = EstimateBytesInFlight(TextureSettings, GenerateDebugTextures);
+	Job.Callback = MoveTemp(Callback);
+
+	const FAtmospherePrecomputeJobHandle Handle{ Job.Id };
+	QueuedJobs.Add(MoveTemp(Job));
+
+	Pump();
+	return Handle;
+}
+
+bool FAtmospherePrecomputeScheduler::Cancel(const FAtmospherePrecomputeJobHandle Handle)
+{
+	check(IsInGameThread());
+
+	if (QueuedJobs.RemoveAll([Handle](const FJob& Job) { return Job.Id == Handle.Id; }) > 0)
+	{
+		return true;
+	}
+
+	if (InFlightJobs.Contains(Handle.Id))
+	{
+		CanceledInFlightJobs.Add(Handle.Id);
+		return true;
+	}
+
+	return false;
+}
+
+void FAtmospherePrecomputeScheduler::SetPriority(const FAtmospherePrecomputeJobHandle Handle, const float Priority)
+{
+	check(IsInGameThread());
+
+	for (auto& Job : QueuedJobs)
+	{
+		if (Job.Id == Handle.Id)
+		{
+			Job.Priority = Priority;
+			break;
+		}
+	}
+}
+
+void FAtmospherePrecomputeScheduler::SetLimits(const int _MaxConcurrentJobs, const uint64 _MaxBytesInFlight)
+{
+	check(IsInGameThread());
+
+	MaxConcurrentJobs = FMath::Max(1, _MaxConcurrentJobs);
+	MaxBytesInFlight = _MaxBytesInFlight;
+	Pump();
+}
+
+uint64 FAtmospherePrecomputeScheduler::EstimateBytesInFlight(const FPrecomputedTextureSettings& TextureSettings, const bool GenerateDebugTextures)
+{
+	const uint64 BytesPerTexel = GPixelFormats[PF_FloatRGBA].BlockBytes;
+	const uint64 TransmittanceBytes = BytesPerTexel
+		* TextureSettings.TransmittanceTextureWidth * TextureSettings.TransmittanceTextureHeight;
+	const uint64 InScatteredLightBytes = BytesPerTexel * TextureSettings.GetNumInScatteredLightTexels();
+
+	// every output texture is a GPU buffer plus a readback staging buffer of the same size,
+	// every debug readback adds another staging buffer.
+	uint64 NumBytes = (GenerateDebugTextures ? 3 : 2) * (TransmittanceBytes + InScatteredLightBytes);
+
+	if (TextureSettings.BuildTransmittanceFromOpticalDepth)
+	{
+		// intermediate optical depth buffer, see FPrecomputedTextureSettings::BuildTransmittanceFromOpticalDepth
+		const uint64 OpticalDepthBytes = GPixelFormats[PF_A32B32G32R32F].BlockBytes
+			* FMath::Max(TextureSettings.TransmittanceTextureWidth, TextureSettings.TransmittanceTextureHeight)
+			* (8 * TextureSettings.TransmittanceSampleSteps + 1);
+		NumBytes += (GenerateDebugTextures ? 2 : 1) * OpticalDepthBytes;
+	}
+
+	if (TextureSettings.AdaptiveRefinement && !TextureSettings.OuterShellOnly)
+	{
+		// intermediate brick corners and refinement flags, see FPrecomputedTextureSettings::AdaptiveRefinement
+		const FIntVector NumBricks = (TextureSettings.GetInScatteredLightTextureSize() + FIntVector(2)) / 4;
+		const uint64 NumCorners = uint64(NumBricks.X + 1) * (NumBricks.Y + 1) * (NumBricks.Z + 1);
+		NumBytes += BytesPerTexel * NumCorners + sizeof(uint32) * NumBricks.X * NumBricks.Y * NumBricks.Z;
+	}
+
+	return NumBytes;
+}
+
+void FAtmospherePrecomputeScheduler::Pump()
+{
+	while (!QueuedJobs.IsEmpty() && InFlightJobs.Num() < MaxConcurrentJobs)
+	{
+		// find the most important job
+		int JobIndex = 0;
+		for (int i = 1; i < QueuedJobs.Num(); i++)
+		{
+			if (QueuedJobs[i].Priority < QueuedJobs[JobIndex].Priority)
+			{
+				JobIndex = i;
+			}
+		}
+
+		if (!InFlightJobs.IsEmpty() && BytesInFlight + QueuedJobs[JobIndex].NumBytes > MaxBytesInFlight)
+		{
+			// wait for in-flight jobs to release their memory
+			return;
+		}
+
+		FJob Job = MoveTemp(QueuedJobs[JobIndex]);
+		QueuedJobs.RemoveAt(JobIndex);
+
+		InFlightJobs.Add(Job.Id, Job.NumBytes);
+		BytesInFlight += Job.NumBytes;
+
+		FAtmospherePrecomputeShaderDispatcher::Dispatch(
+			Job.TextureSettings,
+			Job.Ctx,
+			Job.GenerateDebugTextures,
+			[JobId = Job.Id, Callback = MoveTemp(Job.Callback)](FAtmospherePrecomputedTextureData TextureData, FAtmospherePrecomputedDebugTextureData DebugTextureData) {
+				Get().OnJobCompleted(JobId, Callback, MoveTemp(TextureData), MoveTemp(DebugTextureData));
+			});
+	}
+}
+
+void FAtmospherePrecomputeScheduler::OnJobCompleted(
+	const uint64 JobId,
+	const FCallback& Callback,
+	FAtmospherePrecomputedTextureData TextureData,
+	FAtmospherePrecomputedDebugTextureData DebugTextureData)
+{
+	BytesInFlight -= InFlightJobs.FindAndRemoveChecked(JobId);
+
+	if (!CanceledInFlightJobs.Remove(JobId))
+	{
+		Callback(MoveTemp(TextureData), MoveTemp(DebugTextureData));
+	}
+
+	Pump();
+}
@@ -2,6 +2,9 @@
 
 #include "RHIGPUReadback.h"
 #include "RenderGraphUtils.h"
+#include "RenderResource.h"
+#include "DataDrivenShaderPlatformInfo.h"
+#include "Algo/AnyOf.h"
 
 #define PARTICLE_PROFILE_FIELD_NAME(ProfileIndex, Name) ParticleProfile_##ProfileIndex##_##Name
 
@@ -19,6 +22,7 @@
 
 #define DEFINE_PRECOMPUTE_CONTEXT_FIELDS()                          \
 	LAYOUT_FIELD(FShaderParameter, AtmosphereScale)		/* float */ \
+	LAYOUT_FIELD(FShaderParameter, HueShift)			/* float */ \
 	LAYOUT_FIELD(FShaderParameter, NumParticleProfiles) /* int */   \
 	PARTICLE_PROFILE_FIELDS(0)                                      \
 	PARTICLE_PROFILE_FIELDS(1)                                      \
@@ -43,6 +47,7 @@
 
 #define BIND_PRECOMPUTE_CONTEXT_FIELDS(Index)                                        \
 	AtmosphereScale.Bind(Initializer.ParameterMap, TEXT("AtmosphereScale"));         \
+	HueShift.Bind(Initializer.ParameterMap, TEXT("HueShift"));                       \
 	NumParticleProfiles.Bind(Initializer.ParameterMap, TEXT("NumParticleProfiles")); \
 	BIND_PARTICLE_PROFILE_FIELDS(0)                                                  \
 	BIND_PARTICLE_PROFILE_FIELDS(1)                                                  \
@@ -64,6 +69,7 @@
 
 #define SET_PRECOMPUTE_CONTEXT_FIELDS()                                              \
 	SetShaderValue(BatchedParameters, AtmosphereScale, Ctx.AtmosphereScale);         \
+	SetShaderValue(BatchedParameters, HueShift, Ctx.HueShift);                       \
 	SetShaderValue(BatchedParameters, NumParticleProfiles, Ctx.NumParticleProfiles); \
 	SET_PARTICLE_PROFILE_FIELDS(0)                                                   \
 	SET_PARTICLE_PROFILE_FIELDS(1)                                                   \
@@ -71,6 +77,61 @@
 	SET_PARTICLE_PROFILE_FIELDS(3)                                                   \
 	SET_PARTICLE_PROFILE_FIELDS(4)
 
+#define DEFINE_SCATTERING_LUT_FIELDS()                                       \
+	LAYOUT_FIELD(FShaderResourceParameter, ScatteringLUTIn) /* Buffer<float4> */ \
+	LAYOUT_FIELD(FShaderParameter, ScatteringLUTSize)		/* int */
+
+#define BIND_SCATTERING_LUT_FIELDS()                                         \
+	ScatteringLUTIn.Bind(Initializer.ParameterMap, TEXT("ScatteringLUTIn")); \
+	ScatteringLUTSize.Bind(Initializer.ParameterMap, TEXT("ScatteringLUTSize"));
+
+#define SET_SCATTERING_LUT_FIELDS()                                        \
+	SetSRVParameter(BatchedParameters, ScatteringLUTIn, _ScatteringLUTIn); \
+	SetShaderValue(BatchedParameters, ScatteringLUTSize, _ScatteringLUTSize);
+
+class FScatteringLUTPrecomputeCS : public FGlobalShader
+{
+	DECLARE_SHADER_TYPE(FScatteringLUTPrecomputeCS, Global);
+
+	LAYOUT_FIELD(FShaderResourceParameter, ScatteringLUTOut); // RWBuffer<float4>
+	LAYOUT_FIELD(FShaderParameter, ScatteringLUTSize);		  // int
+
+	DEFINE_PRECOMPUTE_CONTEXT_FIELDS()
+
+	/**
+	 * The amount of threads per group. Must match the shader's numthreads.
+	 */
+	static constexpr int ThreadGroupSize = 64;
+
+	/** Default constructor. */
+	FScatteringLUTPrecomputeCS() {}
+
+	/** Initialization constructor. */
+	FScatteringLUTPrecomputeCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		ScatteringLUTOut.Bind(Initializer.ParameterMap, TEXT("ScatteringLUTOut"));
+		ScatteringLUTSize.Bind(Initializer.ParameterMap, TEXT("ScatteringLUTSize"));
+		BIND_PRECOMPUTE_CONTEXT_FIELDS();
+	}
+
+	void SetParameters(FRHIBatchedShaderParameters& BatchedParameters,
+		FRHIUnorderedAccessView* _ScatteringLUTOut,
+		int _ScatteringLUTSize,
+		const FPrecomputeContext& Ctx) const
+	{
+		SetUAVParameter(BatchedParameters, ScatteringLUTOut, _ScatteringLUTOut);
+		SetShaderValue(BatchedParameters, ScatteringLUTSize, _ScatteringLUTSize);
+		SET_PRECOMPUTE_CONTEXT_FIELDS();
+	}
+};
+
+IMPLEMENT_SHADER_TYPE(,
+	FScatteringLUTPrecomputeCS,
+	TEXT("/SweetAtmosphere/Precompute/PrecomputeScatteringLUT.usf"),
+	TEXT("PrecomputeScatteringLUTCS"),
+	SF_Compute);
+
 class FTransmittancePrecomputeCS : public FGlobalShader
 {
 	DECLARE_SHADER_TYPE(FTransmittancePrecomputeCS, Global);
@@ -80,6 +141,7 @@ class FTransmittancePrecomputeCS : public FGlobalShader
 	LAYOUT_FIELD(FShaderParameter, TransmittanceTextureHeight);		 // int
 	LAYOUT_FIELD(FShaderParameter, NumSteps);						 // int
 
+	DEFINE_SCATTERING_LUT_FIELDS()
 	DEFINE_PRECOMPUTE_CONTEXT_FIELDS()
 
 	/** Default constructor. */
@@ -93,6 +155,7 @@ class FTransmittancePrecomputeCS : public FGlobalShader
 		TransmittanceTextureWidth.Bind(Initializer.ParameterMap, TEXT("TransmittanceTextureWidth"));
 		TransmittanceTextureHeight.Bind(Initializer.ParameterMap, TEXT("TransmittanceTextureHeight"));
 		NumSteps.Bind(Initializer.ParameterMap, TEXT("NumSteps"));
+		BIND_SCATTERING_LUT_FIELDS();
 		BIND_PRECOMPUTE_CONTEXT_FIELDS();
 	}
 
@@ -100,12 +163,14 @@ class FTransmittancePrecomputeCS : public FGlobalShader
 		FRHIUnorderedAccessView* _TransmittanceTextureOut,
 		int _TransmittanceTextureWidth, int _TransmittanceTextureHeight,
 		int _NumSteps,
+		FRHIShaderResourceView* _ScatteringLUTIn, int _ScatteringLUTSize,
 		const FPrecomputeContext& Ctx) const
 	{
 		SetUAVParameter(BatchedParameters, TransmittanceTextureOut, _TransmittanceTextureOut);
 		SetShaderValue(BatchedParameters, TransmittanceTextureWidth, _TransmittanceTextureWidth);
 		SetShaderValue(BatchedParameters, TransmittanceTextureHeight, _TransmittanceTextureHeight);
 		SetShaderValue(BatchedParameters, NumSteps, _NumSteps);
+		SET_SCATTERING_LUT_FIELDS();
 		SET_PRECOMPUTE_CONTEXT_FIELDS();
 	}
 };
@@ -116,6 +181,108 @@ IMPLEMENT_SHADER_TYPE(,
 	TEXT("PrecomputeTransmittanceCS"),
 	SF_Compute);
 
+class FOpticalDepthPrecomputeCS : public FGlobalShader
+{
+	DECLARE_SHADER_TYPE(FOpticalDepthPrecomputeCS, Global);
+
+	LAYOUT_FIELD(FShaderResourceParameter, OpticalDepthOut); // RWBuffer<float4>
+	LAYOUT_FIELD(FShaderParameter, NumChords);				 // int
+	LAYOUT_FIELD(FShaderParameter, NumChordSamples);		 // int
+
+	DEFINE_SCATTERING_LUT_FIELDS()
+	DEFINE_PRECOMPUTE_CONTEXT_FIELDS()
+
+	/**
+	 * The amount of threads per group. Must match the shader's numthreads.
+	 */
+	static constexpr int ThreadGroupSize = 64;
+
+	/** Default constructor. */
+	FOpticalDepthPrecomputeCS() {}
+
+	/** Initialization constructor. */
+	FOpticalDepthPrecomputeCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		OpticalDepthOut.Bind(Initializer.ParameterMap, TEXT("OpticalDepthOut"));
+		NumChords.Bind(Initializer.ParameterMap, TEXT("NumChords"));
+		NumChordSamples.Bind(Initializer.ParameterMap, TEXT("NumChordSamples"));
+		BIND_SCATTERING_LUT_FIELDS();
+		BIND_PRECOMPUTE_CONTEXT_FIELDS();
+	}
+
+	void SetParameters(FRHIBatchedShaderParameters& BatchedParameters,
+		FRHIUnorderedAccessView* _OpticalDepthOut,
+		int _NumChords, int _NumChordSamples,
+		FRHIShaderResourceView* _ScatteringLUTIn, int _ScatteringLUTSize,
+		const FPrecomputeContext& Ctx) const
+	{
+		SetUAVParameter(BatchedParameters, OpticalDepthOut, _OpticalDepthOut);
+		SetShaderValue(BatchedParameters, NumChords, _NumChords);
+		SetShaderValue(BatchedParameters, NumChordSamples, _NumChordSamples);
+		SET_SCATTERING_LUT_FIELDS();
+		SET_PRECOMPUTE_CONTEXT_FIELDS();
+	}
+};
+
+IMPLEMENT_SHADER_TYPE(,
+	FOpticalDepthPrecomputeCS,
+	TEXT("/SweetAtmosphere/Precompute/PrecomputeTransmittance.usf"),
+	TEXT("PrecomputeOpticalDepthCS"),
+	SF_Compute);
+
+class FTransmittanceFromOpticalDepthCS : public FGlobalShader
+{
+	DECLARE_SHADER_TYPE(FTransmittanceFromOpticalDepthCS, Global);
+
+	LAYOUT_FIELD(FShaderResourceParameter, OpticalDepthIn);			 // Buffer<float4>
+	LAYOUT_FIELD(FShaderParameter, NumChords);						 // int
+	LAYOUT_FIELD(FShaderParameter, NumChordSamples);				 // int
+	LAYOUT_FIELD(FShaderResourceParameter, TransmittanceTextureOut); // RWBuffer<float4>
+	LAYOUT_FIELD(FShaderParameter, TransmittanceTextureWidth);		 // int
+	LAYOUT_FIELD(FShaderParameter, TransmittanceTextureHeight);		 // int
+
+	DEFINE_PRECOMPUTE_CONTEXT_FIELDS()
+
+	/** Default constructor. */
+	FTransmittanceFromOpticalDepthCS() {}
+
+	/** Initialization constructor. */
+	FTransmittanceFromOpticalDepthCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		OpticalDepthIn.Bind(Initializer.ParameterMap, TEXT("OpticalDepthIn"));
+		NumChords.Bind(Initializer.ParameterMap, TEXT("NumChords"));
+		NumChordSamples.Bind(Initializer.ParameterMap, TEXT("NumChordSamples"));
+		TransmittanceTextureOut.Bind(Initializer.ParameterMap, TEXT("TransmittanceTextureOut"));
+		TransmittanceTextureWidth.Bind(Initializer.ParameterMap, TEXT("TransmittanceTextureWidth"));
+		TransmittanceTextureHeight.Bind(Initializer.ParameterMap, TEXT("TransmittanceTextureHeight"));
+		BIND_PRECOMPUTE_CONTEXT_FIELDS();
+	}
+
+	void SetParameters(FRHIBatchedShaderParameters& BatchedParameters,
+		FRHIShaderResourceView* _OpticalDepthIn,
+		int _NumChords, int _NumChordSamples,
+		FRHIUnorderedAccessView* _TransmittanceTextureOut,
+		int _TransmittanceTextureWidth, int _TransmittanceTextureHeight,
+		const FPrecomputeContext& Ctx) const
+	{
+		SetSRVParameter(BatchedParameters, OpticalDepthIn, _OpticalDepthIn);
+		SetShaderValue(BatchedParameters, NumChords, _NumChords);
+		SetShaderValue(BatchedParameters, NumChordSamples, _NumChordSamples);
+		SetUAVParameter(BatchedParameters, TransmittanceTextureOut, _TransmittanceTextureOut);
+		SetShaderValue(BatchedParameters, TransmittanceTextureWidth, _TransmittanceTextureWidth);
+		SetShaderValue(BatchedParameters, TransmittanceTextureHeight, _TransmittanceTextureHeight);
+		SET_PRECOMPUTE_CONTEXT_FIELDS();
+	}
+};
+
+IMPLEMENT_SHADER_TYPE(,
+	FTransmittanceFromOpticalDepthCS,
+	TEXT("/SweetAtmosphere/Precompute/PrecomputeTransmittance.usf"),
+	TEXT("PrecomputeTransmittanceFromOpticalDepthCS"),
+	SF_Compute);
+
 class FInScatteredLightPrecomputeCS : public FGlobalShader
 {
 	DECLARE_SHADER_TYPE(FInScatteredLightPrecomputeCS, Global);
@@ -124,9 +291,10 @@ class FInScatteredLightPrecomputeCS : public FGlobalShader
 	LAYOUT_FIELD(FShaderParameter, TransmittanceTextureWidth);			// int
 	LAYOUT_FIELD(FShaderParameter, TransmittanceTextureHeight);			// int
 	LAYOUT_FIELD(FShaderResourceParameter, InScatteredLightTextureOut); // RWBuffer<float4>
-	LAYOUT_FIELD(FShaderParameter, InScatteredLightTextureSize);		// int
+	LAYOUT_FIELD(FShaderParameter, InScatteredLightTextureSize);		// int3
 	LAYOUT_FIELD(FShaderParameter, NumSteps);							// int
 
+	DEFINE_SCATTERING_LUT_FIELDS()
 	DEFINE_PRECOMPUTE_CONTEXT_FIELDS()
 
 	/** Default constructor. */
@@ -142,67 +310,622 @@ class FInScatteredLightPrecomputeCS : public FGlobalShader
 		InScatteredLightTextureOut.Bind(Initializer.ParameterMap, TEXT("InScatteredLightTextureOut"));
 		InScatteredLightTextureSize.Bind(Initializer.ParameterMap, TEXT("InScatteredLightTextureSize"));
 		NumSteps.Bind(Initializer.ParameterMap, TEXT("NumSteps"));
+		BIND_SCATTERING_LUT_FIELDS();
 		BIND_PRECOMPUTE_CONTEXT_FIELDS();
 	}
 
-	void SetParameters(FRHIBatchedShaderParameters& BatchedParameters,
-		FRHIShaderResourceView* _TransmittanceTextureIn,
-		int _TransmittanceTextureWidth, int _TransmittanceTextureHeight,
-		FRHIUnorderedAccessView* _InScatteredLightTextureOut,
-		int _InScatteredLightTextureSize,
-		int _NumSteps,
-		const FPrecomputeContext& Ctx) const
+	void SetParameters(FRHIBatchedShaderParameters& BatchedParameters,
+		FRHIShaderResourceView* _TransmittanceTextureIn,
+		int _TransmittanceTextureWidth, int _TransmittanceTextureHeight,
+		FRHIUnorderedAccessView* _InScatteredLightTextureOut,
+		const FIntVector& _InScatteredLightTextureSize,
+		int _NumSteps,
+		FRHIShaderResourceView* _ScatteringLUTIn, int _ScatteringLUTSize,
+		const FPrecomputeContext& Ctx) const
+	{
+		SetSRVParameter(BatchedParameters, TransmittanceTextureIn, _TransmittanceTextureIn);
+		SetShaderValue(BatchedParameters, TransmittanceTextureWidth, _TransmittanceTextureWidth);
+		SetShaderValue(BatchedParameters, TransmittanceTextureHeight, _TransmittanceTextureHeight);
+		SetUAVParameter(BatchedParameters, InScatteredLightTextureOut, _InScatteredLightTextureOut);
+		SetShaderValue(BatchedParameters, InScatteredLightTextureSize, _InScatteredLightTextureSize);
+		SetShaderValue(BatchedParameters, NumSteps, _NumSteps);
+		SET_SCATTERING_LUT_FIELDS();
+		SET_PRECOMPUTE_CONTEXT_FIELDS();
+	}
+};
+
+IMPLEMENT_SHADER_TYPE(,
+	FInScatteredLightPrecomputeCS,
+	TEXT("/SweetAtmosphere/Precompute/PrecomputeInScatteredLight.usf"),
+	TEXT("PrecomputeInScatteredLightCS"),
+	SF_Compute);
+
+/**
+ * Precomputes the 2D in-scattered light texture for FPrecomputedTextureSettings::OuterShellOnly.
+ * Shares all parameters with FInScatteredLightPrecomputeCS.
+ */
+class FOuterShellInScatteredLightPrecomputeCS : public FInScatteredLightPrecomputeCS
+{
+	DECLARE_SHADER_TYPE(FOuterShellInScatteredLightPrecomputeCS, Global);
+
+	/** Default constructor. */
+	FOuterShellInScatteredLightPrecomputeCS() {}
+
+	/** Initialization constructor. */
+	FOuterShellInScatteredLightPrecomputeCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FInScatteredLightPrecomputeCS(Initializer) {}
+};
+
+IMPLEMENT_SHADER_TYPE(,
+	FOuterShellInScatteredLightPrecomputeCS,
+	TEXT("/SweetAtmosphere/Precompute/PrecomputeInScatteredLight.usf"),
+	TEXT("PrecomputeOuterShellInScatteredLightCS"),
+	SF_Compute);
+
+/**
+ * Precomputes the in-scattered light texture for FPrecomputedTextureSettings::ShareViewRaysAcrossSunAngles.
+ * Shares all parameters with FInScatteredLightPrecomputeCS.
+ */
+class FSharedInScatteredLightPrecomputeCS : public FInScatteredLightPrecomputeCS
+{
+	DECLARE_SHADER_TYPE(FSharedInScatteredLightPrecomputeCS, Global);
+
+	/**
+	 * The amount of sun angles handled by a single thread group. Must match SUN_ANGLES_PER_GROUP.
+	 */
+	static constexpr int SunAnglesPerGroup = 64;
+
+	/** Default constructor. */
+	FSharedInScatteredLightPrecomputeCS() {}
+
+	/** Initialization constructor. */
+	FSharedInScatteredLightPrecomputeCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FInScatteredLightPrecomputeCS(Initializer) {}
+};
+
+IMPLEMENT_SHADER_TYPE(,
+	FSharedInScatteredLightPrecomputeCS,
+	TEXT("/SweetAtmosphere/Precompute/PrecomputeInScatteredLight.usf"),
+	TEXT("PrecomputeInScatteredLightSharedCS"),
+	SF_Compute);
+
+static TAutoConsoleVariable<int32> CVarPrecomputeWaveIntrinsics(
+	TEXT("r.SweetAtmosphere.PrecomputeWaveIntrinsics"),
+	0,
+	TEXT("Whether to share view rays across sun angles through wave intrinsics on platforms that support them,\n")
+	TEXT("instead of groupshared memory.\n")
+	TEXT("Disabled by default, use r.SweetAtmosphere.ValidateWaveIntrinsics to compare the result on a GPU before enabling it."),
+	ECVF_RenderThreadSafe);
+
+/**
+ * Precomputes the in-scattered light texture for FPrecomputedTextureSettings::ShareViewRaysAcrossSunAngles
+ * on platforms with wave operations. Every thread group is a single wave.
+ * Shares all parameters with FInScatteredLightPrecomputeCS.
+ */
+class FWaveInScatteredLightPrecomputeCS : public FInScatteredLightPrecomputeCS
+{
+	DECLARE_SHADER_TYPE(FWaveInScatteredLightPrecomputeCS, Global);
+
+	class FSunAnglesPerWave : SHADER_PERMUTATION_SPARSE_INT("SUN_ANGLES_PER_WAVE", 16, 32, 64);
+	using FPermutationDomain = TShaderPermutationDomain<FSunAnglesPerWave>;
+
+	/** Default constructor. */
+	FWaveInScatteredLightPrecomputeCS() {}
+
+	/** Initialization constructor. */
+	FWaveInScatteredLightPrecomputeCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FInScatteredLightPrecomputeCS(Initializer) {}
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		// a group must never be larger than a wave
+		const FPermutationDomain PermutationVector(Parameters.PermutationId);
+		const uint32 SunAnglesPerWave = PermutationVector.Get<FSunAnglesPerWave>();
+		return RHISupportsWaveOperations(Parameters.Platform)
+			&& SunAnglesPerWave <= FDataDrivenShaderPlatformInfo::GetMaximumWaveSize(Parameters.Platform);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FInScatteredLightPrecomputeCS::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		OutEnvironment.CompilerFlags.Add(CFLAG_WaveOperations);
+	}
+
+	/**
+	 * Selects the group size for the current GPU, the largest one that fits into its smallest wave.
+	 * The shader identifies threads by their lane index, which is only unique within a group if the group is a single wave.
+	 *
+	 * @return The amount of sun angles per thread group, or 0 if the wave kernel can't be used.
+	 */
+	static int32 GetSunAnglesPerWave()
+	{
+		if (!GRHISupportsWaveOperations || !CVarPrecomputeWaveIntrinsics.GetValueOnRenderThread())
+		{
+			return 0;
+		}
+
+		for (const int32 SunAnglesPerWave : { 64, 32, 16 })
+		{
+			if (SunAnglesPerWave <= GRHIMinimumWaveSize)
+			{
+				return SunAnglesPerWave;
+			}
+		}
+		return 0;
+	}
+};
+
+IMPLEMENT_SHADER_TYPE(,
+	FWaveInScatteredLightPrecomputeCS,
+	TEXT("/SweetAtmosphere/Precompute/PrecomputeInScatteredLight.usf"),
+	TEXT("PrecomputeInScatteredLightWaveCS"),
+	SF_Compute);
+
+/**
+ * Precomputes the corners of every brick for FPrecomputedTextureSettings::AdaptiveRefinement.
+ * The other adaptive refinement passes share all parameters with this one.
+ */
+class FAdaptiveInScatteredLightPrecomputeCS : public FInScatteredLightPrecomputeCS
+{
+	DECLARE_SHADER_TYPE(FAdaptiveInScatteredLightPrecomputeCS, Global);
+
+	LAYOUT_FIELD(FShaderResourceParameter, CoarseInScatteredLightIn); // Buffer<float4>
+	LAYOUT_FIELD(FShaderResourceParameter, BrickRefinementFlagsOut);  // RWBuffer<uint>
+	LAYOUT_FIELD(FShaderResourceParameter, BrickRefinementFlagsIn);	  // Buffer<uint>
+	LAYOUT_FIELD(FShaderParameter, RefinementThreshold);			  // float
+
+	/**
+	 * The edge length of a brick in texels. Must match REFINEMENT_BRICK_SIZE.
+	 */
+	static constexpr int BrickSize = 4;
+
+	/** Default constructor. */
+	FAdaptiveInScatteredLightPrecomputeCS() {}
+
+	/** Initialization constructor. */
+	FAdaptiveInScatteredLightPrecomputeCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FInScatteredLightPrecomputeCS(Initializer)
+	{
+		CoarseInScatteredLightIn.Bind(Initializer.ParameterMap, TEXT("CoarseInScatteredLightIn"));
+		BrickRefinementFlagsOut.Bind(Initializer.ParameterMap, TEXT("BrickRefinementFlagsOut"));
+		BrickRefinementFlagsIn.Bind(Initializer.ParameterMap, TEXT("BrickRefinementFlagsIn"));
+		RefinementThreshold.Bind(Initializer.ParameterMap, TEXT("RefinementThreshold"));
+	}
+
+	/**
+	 * @return The amount of bricks along every axis of an in-scattered light texture of the given size.
+	 */
+	static FIntVector GetNumBricks(const FIntVector& TextureSize)
+	{
+		return FIntVector(
+			FMath::Max(1, FMath::DivideAndRoundUp(TextureSize.X - 1, BrickSize)),
+			FMath::Max(1, FMath::DivideAndRoundUp(TextureSize.Y - 1, BrickSize)),
+			FMath::Max(1, FMath::DivideAndRoundUp(TextureSize.Z - 1, BrickSize)));
+	}
+
+	void SetParameters(FRHIBatchedShaderParameters& BatchedParameters,
+		FRHIShaderResourceView* _TransmittanceTextureIn,
+		int _TransmittanceTextureWidth, int _TransmittanceTextureHeight,
+		FRHIUnorderedAccessView* _InScatteredLightTextureOut,
+		const FIntVector& _InScatteredLightTextureSize,
+		int _NumSteps,
+		FRHIShaderResourceView* _ScatteringLUTIn, int _ScatteringLUTSize,
+		const FPrecomputeContext& Ctx,
+		FRHIShaderResourceView* _CoarseInScatteredLightIn,
+		FRHIUnorderedAccessView* _BrickRefinementFlagsOut,
+		FRHIShaderResourceView* _BrickRefinementFlagsIn,
+		float _RefinementThreshold) const
+	{
+		FInScatteredLightPrecomputeCS::SetParameters(BatchedParameters,
+			_TransmittanceTextureIn, _TransmittanceTextureWidth, _TransmittanceTextureHeight,
+			_InScatteredLightTextureOut, _InScatteredLightTextureSize,
+			_NumSteps,
+			_ScatteringLUTIn, _ScatteringLUTSize,
+			Ctx);
+		SetSRVParameter(BatchedParameters, CoarseInScatteredLightIn, _CoarseInScatteredLightIn);
+		SetUAVParameter(BatchedParameters, BrickRefinementFlagsOut, _BrickRefinementFlagsOut);
+		SetSRVParameter(BatchedParameters, BrickRefinementFlagsIn, _BrickRefinementFlagsIn);
+		SetShaderValue(BatchedParameters, RefinementThreshold, _RefinementThreshold);
+	}
+};
+
+IMPLEMENT_SHADER_TYPE(,
+	FAdaptiveInScatteredLightPrecomputeCS,
+	TEXT("/SweetAtmosphere/Precompute/PrecomputeInScatteredLight.usf"),
+	TEXT("PrecomputeInScatteredLightCoarseCS"),
+	SF_Compute);
+
+/**
+ * Flags the bricks that need to be ray marched for FPrecomputedTextureSettings::AdaptiveRefinement.
+ */
+class FEstimateInScatteredLightRefinementCS : public FAdaptiveInScatteredLightPrecomputeCS
+{
+	DECLARE_SHADER_TYPE(FEstimateInScatteredLightRefinementCS, Global);
+
+	/** Default constructor. */
+	FEstimateInScatteredLightRefinementCS() {}
+
+	/** Initialization constructor. */
+	FEstimateInScatteredLightRefinementCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FAdaptiveInScatteredLightPrecomputeCS(Initializer) {}
+};
+
+IMPLEMENT_SHADER_TYPE(,
+	FEstimateInScatteredLightRefinementCS,
+	TEXT("/SweetAtmosphere/Precompute/PrecomputeInScatteredLight.usf"),
+	TEXT("EstimateInScatteredLightRefinementCS"),
+	SF_Compute);
+
+/**
+ * Fills every brick for FPrecomputedTextureSettings::AdaptiveRefinement, by ray marching or interpolation.
+ */
+class FRefineInScatteredLightPrecomputeCS : public FAdaptiveInScatteredLightPrecomputeCS
+{
+	DECLARE_SHADER_TYPE(FRefineInScatteredLightPrecomputeCS, Global);
+
+	/** Default constructor. */
+	FRefineInScatteredLightPrecomputeCS() {}
+
+	/** Initialization constructor. */
+	FRefineInScatteredLightPrecomputeCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FAdaptiveInScatteredLightPrecomputeCS(Initializer) {}
+};
+
+IMPLEMENT_SHADER_TYPE(,
+	FRefineInScatteredLightPrecomputeCS,
+	TEXT("/SweetAtmosphere/Precompute/PrecomputeInScatteredLight.usf"),
+	TEXT("PrecomputeInScatteredLightRefineCS"),
+	SF_Compute);
+
+class FStatisticsCS : public FGlobalShader
+{
+	DECLARE_SHADER_TYPE(FStatisticsCS, Global);
+
+	LAYOUT_FIELD(FShaderResourceParameter, TextureIn);	   // Buffer<float4>
+	LAYOUT_FIELD(FShaderParameter, TextureWidth);		   // int
+	LAYOUT_FIELD(FShaderParameter, TextureHeight);		   // int
+	LAYOUT_FIELD(FShaderResourceParameter, StatisticsOut); // RWBuffer<float4>
+
+	/** Default constructor. */
+	FStatisticsCS() {}
+
+	/** Initialization constructor. */
+	FStatisticsCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		TextureIn.Bind(Initializer.ParameterMap, TEXT("TextureIn"));
+		TextureWidth.Bind(Initializer.ParameterMap, TEXT("TextureWidth"));
+		TextureHeight.Bind(Initializer.ParameterMap, TEXT("TextureHeight"));
+		StatisticsOut.Bind(Initializer.ParameterMap, TEXT("StatisticsOut"));
+	}
+
+	void SetParameters(FRHIBatchedShaderParameters& BatchedParameters,
+		FRHIShaderResourceView* _TextureIn,
+		int _TextureWidth, int _TextureHeight,
+		FRHIUnorderedAccessView* _StatisticsOut) const
+	{
+		SetSRVParameter(BatchedParameters, TextureIn, _TextureIn);
+		SetShaderValue(BatchedParameters, TextureWidth, _TextureWidth);
+		SetShaderValue(BatchedParameters, TextureHeight, _TextureHeight);
+		SetUAVParameter(BatchedParameters, StatisticsOut, _StatisticsOut);
+	}
+};
+
+IMPLEMENT_SHADER_TYPE(,
+	FStatisticsCS,
+	TEXT("/SweetAtmosphere/Precompute/ComputeStatistics.usf"),
+	TEXT("ComputeStatisticsCS"),
+	SF_Compute);
+
+void FAtmospherePrecomputeShaderDispatcher::Dispatch(
+	FPrecomputedTextureSettings TextureSettings,
+	FPrecomputeContext Ctx,
+	bool GenerateDebugTextures,
+	FCallback AsyncCallback,
+	bool CallbackOnGameThread)
+{
+	if (IsInRenderingThread())
+	{
+		DispatchRenderThread(GetImmediateCommandList_ForRenderCommand(),
+			TextureSettings, Ctx, GenerateDebugTextures, AsyncCallback, CallbackOnGameThread);
+	}
+	else
+	{
+		DispatchGameThread(TextureSettings, Ctx, GenerateDebugTextures, AsyncCallback, CallbackOnGameThread);
+	}
+}
+
+/**
+ * Completes a precomputation awaited through a future or a task exactly once.
+ * Completes it with a failed result when destroyed before, e.g. because the callback holding it
+ * has been destroyed without being called, so that nothing waits for it forever.
+ */
+class FPrecomputeCompletion
+{
+public:
+	explicit FPrecomputeCompletion(TUniqueFunction<void(FAtmospherePrecomputeResult&&)>&& OnComplete)
+		: OnComplete(MoveTemp(OnComplete)) {}
+
+	~FPrecomputeCompletion()
+	{
+		Complete(FAtmospherePrecomputeResult());
+	}
+
+	void Complete(FAtmospherePrecomputeResult&& Result)
+	{
+		if (OnComplete)
+		{
+			OnComplete(MoveTemp(Result));
+			OnComplete.Reset();
+		}
+	}
+
+private:
+	TUniqueFunction<void(FAtmospherePrecomputeResult&&)> OnComplete;
+};
+
+TFuture<FAtmospherePrecomputeResult> FAtmospherePrecomputeShaderDispatcher::DispatchFuture(
+	const FPrecomputedTextureSettings& TextureSettings,
+	const FPrecomputeContext& Ctx,
+	const bool GenerateDebugTextures)
+{
+	TPromise<FAtmospherePrecomputeResult> Promise;
+	TFuture<FAtmospherePrecomputeResult> Future = Promise.GetFuture();
+
+	// TFunction requires a copyable callback, so share the completion
+	const auto Completion = MakeShared<FPrecomputeCompletion, ESPMode::ThreadSafe>(
+		[Promise = MoveTemp(Promise)](FAtmospherePrecomputeResult&& Result) mutable {
+			Promise.SetValue(MoveTemp(Result));
+		});
+
+	Dispatch(
+		TextureSettings,
+		Ctx,
+		GenerateDebugTextures,
+		[Completion](FAtmospherePrecomputedTextureData TextureData, FAtmospherePrecomputedDebugTextureData DebugTextureData) {
+			Completion->Complete(FAtmospherePrecomputeResult{ MoveTemp(TextureData), MoveTemp(DebugTextureData) });
+		},
+		false);
+
+	return Future;
+}
+
+UE::Tasks::TTask<FAtmospherePrecomputeResult> FAtmospherePrecomputeShaderDispatcher::LaunchTask(
+	const FPrecomputedTextureSettings& TextureSettings,
+	const FPrecomputeContext& Ctx,
+	const bool GenerateDebugTextures,
+	const TArray<UE::Tasks::FTask>& Prerequisites)
+{
+	// the readback completes outside of the task system,
+	// so the result task waits for an event triggered by the callback
+	const auto Result = MakeShared<FAtmospherePrecomputeResult, ESPMode::ThreadSafe>();
+	UE::Tasks::FTaskEvent ReadbackCompleted(TEXT("AtmospherePrecomputeReadback"));
+
+	const auto Completion = MakeShared<FPrecomputeCompletion, ESPMode::ThreadSafe>(
+		[Result, ReadbackCompleted](FAtmospherePrecomputeResult&& CompletedResult) mutable {
+			*Result = MoveTemp(CompletedResult);
+			ReadbackCompleted.Trigger();
+		});
+
+	UE::Tasks::Launch(
+		TEXT("DispatchAtmospherePrecompute"),
+		[TextureSettings, Ctx, GenerateDebugTextures, Completion]() {
+			Dispatch(
+				TextureSettings,
+				Ctx,
+				GenerateDebugTextures,
+				[Completion](FAtmospherePrecomputedTextureData TextureData, FAtmospherePrecomputedDebugTextureData DebugTextureData) {
+					Completion->Complete(FAtmospherePrecomputeResult{ MoveTemp(TextureData), MoveTemp(DebugTextureData) });
+				},
+				false);
+		},
+		Prerequisites);
+
+	return UE::Tasks::Launch(
+		TEXT("AtmospherePrecompute"),
+		[Result]() {
+			return MoveTemp(*Result);
+		},
+		ReadbackCompleted);
+}
+
+void FAtmospherePrecomputeShaderDispatcher::DispatchGameThread(
+	FPrecomputedTextureSettings TextureSettings,
+	FPrecomputeContext GenerationSettings,
+	bool GenerateDebugTextures,
+	FCallback AsyncCallback,
+	bool CallbackOnGameThread)
+{
+	ENQUEUE_RENDER_COMMAND(SceneDrawCompletion)
+	(
+		[TextureSettings, GenerationSettings, AsyncCallback, GenerateDebugTextures, CallbackOnGameThread](FRHICommandListImmediate& RHICmdList) {
+			DispatchRenderThread(RHICmdList, TextureSettings, GenerationSettings, GenerateDebugTextures, AsyncCallback, CallbackOnGameThread);
+		});
+}
+
+static TAutoConsoleVariable<int32> CVarPrecomputePoolSize(
+	TEXT("r.SweetAtmosphere.PrecomputePoolSize"),
+	256,
+	TEXT("The maximum memory in MB of unused precompute buffers and readback staging buffers kept for reuse."),
+	ECVF_RenderThreadSafe);
+
+/**
+ * Recycles the GPU buffers, their views and the readback staging buffers of precomputations,
+ * keyed by their size and format, so that repeatedly precomputing same-sized textures doesn't allocate.
+ * Unused entries are released oldest first once they exceed r.SweetAtmosphere.PrecomputePoolSize.
+ */
+class FPrecomputeBufferPool : public FRenderResource
+{
+public:
+	struct FBuffer
+	{
+		FBufferRHIRef Buffer;
+		FShaderResourceViewRHIRef SRV;
+		FUnorderedAccessViewRHIRef UAV;
+		FIntVector Size;
+		EPixelFormat PixelFormat;
+		uint64 NumBytes;
+	};
+
+	/**
+	 * Returns an unused buffer of the given size and format, or creates one.
+	 * The buffer returns to the pool once the last reference to it is released.
+	 */
+	TSharedRef<FBuffer, ESPMode::ThreadSafe> AcquireBuffer(
+		FRHICommandList& RHICmdList,
+		const FIntVector& Size,
+		const EPixelFormat PixelFormat,
+		const FString& Name)
+	{
+		FBuffer* Buffer = nullptr;
+		{
+			FScopeLock Lock(&CriticalSection);
+			const int32 Index = FreeBuffers.FindLastByPredicate([&Size, PixelFormat](const FBuffer* Free) {
+				return Free->Size == Size && Free->PixelFormat == PixelFormat;
+			});
+			if (Index != INDEX_NONE)
+			{
+				Buffer = FreeBuffers[Index];
+				FreeBuffers.RemoveAt(Index);
+				FreeBytes -= Buffer->NumBytes;
+			}
+		}
+
+		if (!Buffer)
+		{
+			Buffer = new FBuffer();
+			Buffer->Size = Size;
+			Buffer->PixelFormat = PixelFormat;
+			Buffer->NumBytes = GPixelFormats[PixelFormat].Get3DImageSizeInBytes(Size.X, Size.Y, FMath::Max(1, Size.Z));
+
+			FRHIResourceCreateInfo BufferCreateInfo(*Name);
+			Buffer->Buffer = RHICmdList.CreateBuffer(Buffer->NumBytes,
+				EBufferUsageFlags::ShaderResource | EBufferUsageFlags::UnorderedAccess, 1,
+				ERHIAccess::None,
+				BufferCreateInfo);
+		}
+
+		return MakeShareable(Buffer, [this](FBuffer* Released) {
+			ReleaseBuffer(Released);
+		});
+	}
+
+	/**
+	 * Returns an unused readback whose staging buffer was last used to copy a buffer of the given size, or creates one.
+	 */
+	FRHIGPUBufferReadback* AcquireReadback(const uint64 NumBytes, const FName& Name)
+	{
+		{
+			FScopeLock Lock(&CriticalSection);
+			const int32 Index = FreeReadbacks.FindLastByPredicate([NumBytes](const FReadback& Free) {
+				return Free.NumBytes == NumBytes;
+			});
+			if (Index != INDEX_NONE)
+			{
+				FRHIGPUBufferReadback* Readback = FreeReadbacks[Index].Readback;
+				FreeReadbacks.RemoveAt(Index);
+				FreeBytes -= NumBytes;
+				return Readback;
+			}
+		}
+
+		return new FRHIGPUBufferReadback(Name);
+	}
+
+	/**
+	 * Returns a readback that has been read to the pool.
+	 *
+	 * @param NumBytes The size of the buffer the readback copied.
+	 */
+	void ReleaseReadback(FRHIGPUBufferReadback* Readback, const uint64 NumBytes)
+	{
+		FScopeLock Lock(&CriticalSection);
+		if (!IsInitialized())
+		{
+			delete Readback;
+			return;
+		}
+
+		FreeReadbacks.Add({ Readback, NumBytes });
+		FreeBytes += NumBytes;
+		Trim();
+	}
+
+	virtual void ReleaseRHI() override
 	{
-		SetSRVParameter(BatchedParameters, TransmittanceTextureIn, _TransmittanceTextureIn);
-		SetShaderValue(BatchedParameters, TransmittanceTextureWidth, _TransmittanceTextureWidth);
-		SetShaderValue(BatchedParameters, TransmittanceTextureHeight, _TransmittanceTextureHeight);
-		SetUAVParameter(BatchedParameters, InScatteredLightTextureOut, _InScatteredLightTextureOut);
-		SetShaderValue(BatchedParameters, InScatteredLightTextureSize, _InScatteredLightTextureSize);
-		SetShaderValue(BatchedParameters, NumSteps, _NumSteps);
-		SET_PRECOMPUTE_CONTEXT_FIELDS();
+		FScopeLock Lock(&CriticalSection);
+		for (const FBuffer* Buffer : FreeBuffers)
+		{
+			delete Buffer;
+		}
+		for (const auto& Free : FreeReadbacks)
+		{
+			delete Free.Readback;
+		}
+		FreeBuffers.Empty();
+		FreeReadbacks.Empty();
+		FreeBytes = 0;
 	}
-};
 
-IMPLEMENT_SHADER_TYPE(,
-	FInScatteredLightPrecomputeCS,
-	TEXT("/SweetAtmosphere/Precompute/PrecomputeInScatteredLight.usf"),
-	TEXT("PrecomputeInScatteredLightCS"),
-	SF_Compute);
+private:
+	struct FReadback
+	{
+		FRHIGPUBufferReadback* Readback;
+		uint64 NumBytes;
+	};
 
-void FAtmospherePrecomputeShaderDispatcher::Dispatch(
-	FPrecomputedTextureSettings TextureSettings,
-	FPrecomputeContext Ctx,
-	bool GenerateDebugTextures,
-	TFunction<void(FAtmospherePrecomputedTextureData, FAtmospherePrecomputedDebugTextureData)> AsyncCallback)
-{
-	if (IsInRenderingThread())
+	FCriticalSection CriticalSection;
+
+	/**
+	 * Unused entries, the most recently released last.
+	 */
+	TArray<FBuffer*> FreeBuffers;
+	TArray<FReadback> FreeReadbacks;
+	uint64 FreeBytes = 0;
+
+	void ReleaseBuffer(FBuffer* Buffer)
 	{
-		DispatchRenderThread(GetImmediateCommandList_ForRenderCommand(),
-			TextureSettings, Ctx, GenerateDebugTextures, AsyncCallback);
+		FScopeLock Lock(&CriticalSection);
+		if (!IsInitialized())
+		{
+			delete Buffer;
+			return;
+		}
+
+		FreeBuffers.Add(Buffer);
+		FreeBytes += Buffer->NumBytes;
+		Trim();
 	}
-	else
+
+	/**
+	 * Releases the oldest unused entries until the pool fits into its size limit.
+	 */
+	void Trim()
 	{
-		DispatchGameThread(TextureSettings, Ctx, GenerateDebugTextures, AsyncCallback);
+		const uint64 MaxFreeBytes = static_cast<uint64>(FMath::Max(0, CVarPrecomputePoolSize.GetValueOnAnyThread())) * 1024 * 1024;
+		while (FreeBytes > MaxFreeBytes && !FreeBuffers.IsEmpty())
+		{
+			FreeBytes -= FreeBuffers[0]->NumBytes;
+			delete FreeBuffers[0];
+			FreeBuffers.RemoveAt(0);
+		}
+		while (FreeBytes > MaxFreeBytes && !FreeReadbacks.IsEmpty())
+		{
+			FreeBytes -= FreeReadbacks[0].NumBytes;
+			delete FreeReadbacks[0].Readback;
+			FreeReadbacks.RemoveAt(0);
+		}
 	}
-}
+};
 
-void FAtmospherePrecomputeShaderDispatcher::DispatchGameThread(
-	FPrecomputedTextureSettings TextureSettings,
-	FPrecomputeContext GenerationSettings,
-	bool GenerateDebugTextures,
-	TFunction<void(FAtmospherePrecomputedTextureData, FAtmospherePrecomputedDebugTextureData)> AsyncCallback)
-{
-	ENQUEUE_RENDER_COMMAND(SceneDrawCompletion)
-	(
-		[TextureSettings, GenerationSettings, AsyncCallback, GenerateDebugTextures](FRHICommandListImmediate& RHICmdList) {
-			DispatchRenderThread(RHICmdList, TextureSettings, GenerationSettings, GenerateDebugTextures, AsyncCallback);
-		});
-}
+static TGlobalResource<FPrecomputeBufferPool> GPrecomputeBufferPool;
 
 /**
  * Wrapper class to operate on float4 buffers instead of textures.
  * This is required since macOS Metal doesn't seem to support 3D textures
  * in a compute shader (or I'm too stupid to figure it out).
+ *
+ * Buffers are taken from GPrecomputeBufferPool, and return to it once all copies of this wrapper are gone.
  */
 struct FRHITextureData
 {
@@ -231,40 +954,50 @@ struct FRHITextureData
 
 	FShaderResourceViewRHIRef CreateSRV(FRHICommandList& RHICmdList) const
 	{
-		return RHICmdList.CreateShaderResourceView(Buffer,
-			FRHIViewDesc::CreateBufferSRV()
-				.SetType(FRHIViewDesc::EBufferType::Typed)
-				.SetFormat(PixelFormat)
-				.SetNumElements(Size.X * Size.Y * FMath::Max(Size.Z, 1)));
+		if (!Pooled->SRV)
+		{
+			Pooled->SRV = RHICmdList.CreateShaderResourceView(Buffer,
+				FRHIViewDesc::CreateBufferSRV()
+					.SetType(FRHIViewDesc::EBufferType::Typed)
+					.SetFormat(PixelFormat)
+					.SetNumElements(Size.X * Size.Y * FMath::Max(Size.Z, 1)));
+		}
+		return Pooled->SRV;
 	}
 
 	FUnorderedAccessViewRHIRef CreateUAV(FRHICommandList& RHICmdList) const
 	{
-		return RHICmdList.CreateUnorderedAccessView(Buffer,
-			FRHIViewDesc::CreateBufferUAV()
-				.SetType(FRHIViewDesc::EBufferType::Typed)
-				.SetFormat(PixelFormat)
-				.SetNumElements(Size.X * Size.Y * FMath::Max(Size.Z, 1)));
+		if (!Pooled->UAV)
+		{
+			Pooled->UAV = RHICmdList.CreateUnorderedAccessView(Buffer,
+				FRHIViewDesc::CreateBufferUAV()
+					.SetType(FRHIViewDesc::EBufferType::Typed)
+					.SetFormat(PixelFormat)
+					.SetNumElements(Size.X * Size.Y * FMath::Max(Size.Z, 1)));
+		}
+		return Pooled->UAV;
+	}
+
+	/**
+	 * @return The pooled buffer, to keep it from returning to the pool while it is still needed.
+	 */
+	TSharedRef<FPrecomputeBufferPool::FBuffer, ESPMode::ThreadSafe> GetPooledBuffer() const
+	{
+		return Pooled;
 	}
 
 private:
-	FRHITextureData(const FBufferRHIRef& Buffer, const FIntVector& Size, EPixelFormat PixelFormat, const uint32 NumBytes)
-		: Buffer(Buffer), Size(Size), PixelFormat(PixelFormat), NumBytes(NumBytes) {}
+	TSharedRef<FPrecomputeBufferPool::FBuffer, ESPMode::ThreadSafe> Pooled;
+
+	explicit FRHITextureData(const TSharedRef<FPrecomputeBufferPool::FBuffer, ESPMode::ThreadSafe>& Pooled)
+		: Buffer(Pooled->Buffer), Size(Pooled->Size), PixelFormat(Pooled->PixelFormat), NumBytes(Pooled->NumBytes), Pooled(Pooled) {}
 
 	static FRHITextureData Create(FRHICommandList& RHICmdList,
 		const FIntVector& Size,
 		const EPixelFormat PixelFormat,
 		const FString& Name)
 	{
-		const auto NumBytes = GPixelFormats[PixelFormat].Get3DImageSizeInBytes(Size.X, Size.Y, FMath::Max(1, Size.Z));
-
-		FRHIResourceCreateInfo BufferCreateInfo(*Name);
-		const auto Buffer = RHICmdList.CreateBuffer(NumBytes,
-			EBufferUsageFlags::ShaderResource | EBufferUsageFlags::UnorderedAccess, 1,
-			ERHIAccess::None,
-			BufferCreateInfo);
-
-		return FRHITextureData(Buffer, Size, PixelFormat, NumBytes);
+		return FRHITextureData(GPrecomputeBufferPool.AcquireBuffer(RHICmdList, Size, PixelFormat, Name));
 	}
 };
 
@@ -278,26 +1011,73 @@ struct FTextureDataReadback
 		const auto NumBytes = GPixelFormats[Resource.PixelFormat].Get3DImageSizeInBytes(
 			Resource.Size.X, Resource.Size.Y, Resource.Size.Z);
 
-		auto* Readback = new FRHIGPUBufferReadback(FName(NameIncludingPass + " Readback"));
+		// staging buffers are pooled by the size of the buffer they copy
+		auto* Readback = GPrecomputeBufferPool.AcquireReadback(Resource.NumBytes, FName(NameIncludingPass + " Readback"));
 		Readback->EnqueueCopy(RHICmdList, Resource.Buffer, NumBytes);
-		return new FTextureDataReadback(NameIncludingPass, Resource.Size, Resource.PixelFormat, Readback);
+		return new FTextureDataReadback(NameIncludingPass, Resource, Readback);
+	}
+
+	/**
+	 * Reads back only the given Z slices of a volume texture.
+	 */
+	static FTextureDataReadback* CreateAndEnqueueSlices(
+		FRHICommandList& RHICmdList,
+		const FRHITextureData& Resource, const TArray<int>& Slices, const int Pass, const FString& Name)
+	{
+		check(Resource.Size.Z > 0);
+
+		TArray<int> ValidSlices;
+		TArray<FString> SliceNames;
+		for (const int Slice : Slices)
+		{
+			if (Slice >= 0 && Slice < Resource.Size.Z)
+			{
+				ValidSlices.Add(Slice);
+				SliceNames.Add(FString::FromInt(Slice));
+			}
+		}
+		check(!ValidSlices.IsEmpty());
+
+		const auto SliceNumBytes = GPixelFormats[Resource.PixelFormat].Get3DImageSizeInBytes(
+			Resource.Size.X, Resource.Size.Y, 1);
+		const auto SlicesName = FString::Printf(TEXT("%s Slices %s"), *Name, *FString::Join(SliceNames, TEXT(",")));
+		const auto Region = FRHITextureData::Create3D(RHICmdList,
+			FIntVector(Resource.Size.X, Resource.Size.Y, ValidSlices.Num()),
+			Resource.PixelFormat, SlicesName);
+
+		for (int i = 0; i < ValidSlices.Num(); i++)
+		{
+			RHICmdList.CopyBufferRegion(Region.Buffer, i * SliceNumBytes,
+				Resource.Buffer, ValidSlices[i] * SliceNumBytes, SliceNumBytes);
+		}
+
+		return CreateAndEnqueue(RHICmdList, Region, Pass, SlicesName);
 	}
 
 	const FString Name;
 	FTextureData ReadTextureData;
 
+	~FTextureDataReadback()
+	{
+		if (Readback)
+		{
+			// never read, e.g. because precomputation failed after enqueuing the copy
+			GPrecomputeBufferPool.ReleaseReadback(Readback, SourceBuffer->NumBytes);
+		}
+	}
+
 	bool IsReady() const
 	{
-		return !ReadTextureData.Data.IsEmpty() || (Readback && Readback->IsReady());
+		return Readback && Readback->IsReady();
 	}
 
+	/**
+	 * Moves the read back data out of the GPU buffer.
+	 * Can only be called once.
+	 */
 	FTextureData Read()
 	{
 		check(IsReady());
-		if (!ReadTextureData.Data.IsEmpty())
-		{
-			return ReadTextureData;
-		}
 
 		const auto NumBytes = GPixelFormats[ReadTextureData.PixelFormat].Get3DImageSizeInBytes(
 			ReadTextureData.Size.X, ReadTextureData.Size.Y, ReadTextureData.Size.Z);
@@ -308,10 +1088,11 @@ struct FTextureDataReadback
 		FMemory::Memcpy(ReadTextureData.Data.GetData(), GPUData, NumBytes);
 
 		Readback->Unlock();
-		delete Readback;
+		GPrecomputeBufferPool.ReleaseReadback(Readback, SourceBuffer->NumBytes);
 		Readback = nullptr;
+		SourceBuffer.Reset();
 
-		return ReadTextureData;
+		return MoveTemp(ReadTextureData);
 	}
 
 private:
@@ -320,14 +1101,107 @@ private:
 	 */
 	FRHIGPUBufferReadback* Readback;
 
-	FTextureDataReadback(const FString& Name, const FIntVector& Size, const EPixelFormat PixelFormat, FRHIGPUBufferReadback* const Readback)
-		: Name(Name), ReadTextureData(Size, PixelFormat, {}), Readback(Readback) {}
+	/**
+	 * The buffer being read back, kept from returning to the pool until the copy has completed.
+	 */
+	TSharedPtr<FPrecomputeBufferPool::FBuffer, ESPMode::ThreadSafe> SourceBuffer;
+
+	FTextureDataReadback(const FString& Name, const FRHITextureData& Source, FRHIGPUBufferReadback* const Readback)
+		: Name(Name), ReadTextureData(Source.Size, Source.PixelFormat, {}), Readback(Readback), SourceBuffer(Source.GetPooledBuffer()) {}
 };
 
-#define DEBUG_READBACK(Pass, Resource)                                                                     \
-	if (GenerateDebugTextures)                                                                             \
-	{                                                                                                      \
-		DebugReadbacks.Add(FTextureDataReadback::CreateAndEnqueue(RHICmdList, Resource, Pass, #Resource)); \
+#define DEBUG_READBACK(Pass, Resource)                                                                                                                \
+	if (GenerateDebugTextures)                                                                                                                        \
+	{                                                                                                                                                 \
+		if (Resource.Size.Z > 0 && !TextureSettings.DebugReadbackSlices.IsEmpty())                                                                    \
+		{                                                                                                                                             \
+			DebugReadbacks.Add(FTextureDataReadback::CreateAndEnqueueSlices(RHICmdList, Resource, TextureSettings.DebugReadbackSlices, Pass, #Resource)); \
+		}                                                                                                                                             \
+		else                                                                                                                                          \
+		{                                                                                                                                             \
+			DebugReadbacks.Add(FTextureDataReadback::CreateAndEnqueue(RHICmdList, Resource, Pass, #Resource));                                        \
+		}                                                                                                                                             \
+	}
+
+/**
+ * Reduces a texture to per-slice statistics on the GPU and enqueues a readback of the result.
+ *
+ * @return The readback of the per-slice statistics, or nullptr if the shader isn't available.
+ */
+static FTextureDataReadback* EnqueueStatistics(FRHICommandList& RHICmdList, const FRHITextureData& Resource, const FString& Name)
+{
+	TShaderMapRef<FStatisticsCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	if (!Shader.IsValid())
+	{
+		UE_LOG(LogShaders, Error, TEXT("Statistics shader is not valid"));
+		return nullptr;
+	}
+
+	// three float4 entries per slice, see ComputeStatistics.usf
+	const int NumSlices = FMath::Max(Resource.Size.Z, 1);
+	const auto Statistics = FRHITextureData::Create2D(RHICmdList, 3, NumSlices, PF_A32B32G32R32F, Name + TEXT(" Statistics"));
+
+	SetComputePipelineState(RHICmdList, Shader.GetComputeShader());
+	SetShaderParametersLegacyCS(RHICmdList, Shader,
+		Resource.CreateSRV(RHICmdList), Resource.Size.X, Resource.Size.Y,
+		Statistics.CreateUAV(RHICmdList));
+	RHICmdList.DispatchComputeShader(NumSlices, 1, 1);
+	UnsetShaderUAVs(RHICmdList, Shader, Shader.GetComputeShader());
+
+	return FTextureDataReadback::CreateAndEnqueue(RHICmdList, Statistics, 0, Name);
+}
+
+/**
+ * Combines the per-slice statistics read back from the GPU.
+ */
+static FAtmosphereTextureStatistics ParseStatistics(const FTextureData& StatisticsData)
+{
+	const auto* Entries = reinterpret_cast<const FVector4f*>(StatisticsData.Data.GetData());
+	const int NumSlices = StatisticsData.Size.Y;
+
+	FAtmosphereTextureStatistics Statistics;
+	Statistics.Total.Min = FVector(TNumericLimits<float>::Max());
+	Statistics.Total.Max = FVector(TNumericLimits<float>::Lowest());
+
+	FVector TotalSum = FVector::Zero();
+	int64 TotalNumFinite = 0;
+	for (int i = 0; i < NumSlices; i++)
+	{
+		const FVector4f& MinEntry = Entries[i * 3 + 0];
+		const FVector4f& MaxEntry = Entries[i * 3 + 1];
+		const FVector4f& SumEntry = Entries[i * 3 + 2];
+
+		FAtmosphereTextureSliceStatistics Slice;
+		Slice.Min = FVector(MinEntry.X, MinEntry.Y, MinEntry.Z);
+		Slice.Max = FVector(MaxEntry.X, MaxEntry.Y, MaxEntry.Z);
+		Slice.NumNonFinite = FMath::RoundToInt(MinEntry.W);
+		Slice.NumNegative = FMath::RoundToInt(MaxEntry.W);
+
+		const FVector Sum(SumEntry.X, SumEntry.Y, SumEntry.Z);
+		const int NumFinite = FMath::RoundToInt(SumEntry.W) - Slice.NumNonFinite;
+		Slice.Mean = NumFinite > 0 ? Sum / NumFinite : FVector::Zero();
+
+		Statistics.Total.Min = Statistics.Total.Min.ComponentMin(Slice.Min);
+		Statistics.Total.Max = Statistics.Total.Max.ComponentMax(Slice.Max);
+		Statistics.Total.NumNonFinite += Slice.NumNonFinite;
+		Statistics.Total.NumNegative += Slice.NumNegative;
+		TotalSum += Sum;
+		TotalNumFinite += NumFinite;
+
+		Statistics.Slices.Add(Slice);
+	}
+	Statistics.Total.Mean = TotalNumFinite > 0 ? TotalSum / TotalNumFinite : FVector::Zero();
+
+	return Statistics;
+}
+
+#define STATISTICS_READBACK(Resource)                                                \
+	if (TextureSettings.ComputeStatistics)                                           \
+	{                                                                                \
+		if (auto* Readback = EnqueueStatistics(RHICmdList, Resource, TEXT(#Resource))) \
+		{                                                                            \
+			StatisticsReadbacks.Add(TEXT(#Resource), Readback);                      \
+		}                                                                            \
 	}
 
 #define PARTICLE_PROFILE_PARAMETER_NAME(ProfileIndex, Name) \
@@ -347,6 +1221,7 @@ private:
 
 #define APPLY_PRECOMPUTE_CONTEXT()                             \
 	PassParams->AtmosphereScale = Ctx.AtmosphereScale;         \
+	PassParams->HueShift = Ctx.HueShift;                       \
 	PassParams->NumParticleProfiles = Ctx.NumParticleProfiles; \
 	APPLY_PARTICLE_PROFILE(PassParams, 0)                      \
 	APPLY_PARTICLE_PROFILE(PassParams, 1)                      \
@@ -354,6 +1229,123 @@ private:
 	APPLY_PARTICLE_PROFILE(PassParams, 3)                      \
 	APPLY_PARTICLE_PROFILE(PassParams, 4)
 
+#define APPEND_PARTICLE_PROFILE_KEY(ProfileIndex)                                                \
+	if (Ctx.NumParticleProfiles > ProfileIndex)                                                  \
+	{                                                                                            \
+		Key.Append({                                                                             \
+			Ctx.PARTICLE_PROFILE_PARAMETER_NAME(ProfileIndex, ScatteringCoefficientsR),          \
+			Ctx.PARTICLE_PROFILE_PARAMETER_NAME(ProfileIndex, ScatteringCoefficientsG),          \
+			Ctx.PARTICLE_PROFILE_PARAMETER_NAME(ProfileIndex, ScatteringCoefficientsB),          \
+			static_cast<float>(Ctx.PARTICLE_PROFILE_PARAMETER_NAME(ProfileIndex, PhaseFunction)), \
+			Ctx.PARTICLE_PROFILE_PARAMETER_NAME(ProfileIndex, ExponentFactor),                   \
+			Ctx.PARTICLE_PROFILE_PARAMETER_NAME(ProfileIndex, LinearFadeInSize),                 \
+			Ctx.PARTICLE_PROFILE_PARAMETER_NAME(ProfileIndex, LinearFadeOutSize),                \
+		});                                                                                      \
+	}
+
+/**
+ * All inputs the transmittance texture depends on.
+ * Transmittance doesn't depend on the hue shift or on any in-scattered light setting.
+ */
+using FTransmittanceCacheKey = TArray<float, TInlineAllocator<48>>;
+
+static FTransmittanceCacheKey MakeTransmittanceCacheKey(const FPrecomputedTextureSettings& TextureSettings, const FPrecomputeContext& Ctx)
+{
+	FTransmittanceCacheKey Key = {
+		static_cast<float>(TextureSettings.TransmittanceTextureWidth),
+		static_cast<float>(TextureSettings.TransmittanceTextureHeight),
+		static_cast<float>(TextureSettings.TransmittanceSampleSteps),
+		static_cast<float>(FMath::Max(2, TextureSettings.ScatteringLUTSize)),
+		TextureSettings.BuildTransmittanceFromOpticalDepth ? 1.0f : 0.0f,
+		Ctx.AtmosphereScale,
+		static_cast<float>(Ctx.NumParticleProfiles),
+	};
+	APPEND_PARTICLE_PROFILE_KEY(0)
+	APPEND_PARTICLE_PROFILE_KEY(1)
+	APPEND_PARTICLE_PROFILE_KEY(2)
+	APPEND_PARTICLE_PROFILE_KEY(3)
+	APPEND_PARTICLE_PROFILE_KEY(4)
+	return Key;
+}
+
+static TAutoConsoleVariable<int32> CVarTransmittanceCacheSize(
+	TEXT("r.SweetAtmosphere.TransmittanceCacheSize"),
+	16,
+	TEXT("The maximum memory in MB of precomputed transmittance kept on the GPU for reuse by later precomputations of the same transmittance inputs. 0 disables the cache."),
+	ECVF_RenderThreadSafe);
+
+/**
+ * Keeps the most recently precomputed transmittance textures on the GPU, keyed by all of their inputs,
+ * so that precomputations which only differ in their in-scattered light settings skip the transmittance pass.
+ * Entries are released least recently used first once they exceed r.SweetAtmosphere.TransmittanceCacheSize,
+ * which returns their buffers to GPrecomputeBufferPool. Only accessed from the render thread.
+ */
+class FTransmittanceCache : public FRenderResource
+{
+public:
+	/**
+	 * @return The cached transmittance of the given inputs, if any.
+	 */
+	TOptional<FRHITextureData> Find(const FTransmittanceCacheKey& Key)
+	{
+		check(IsInRenderingThread());
+		const int32 Index = Entries.IndexOfByPredicate([&Key](const FEntry& Entry) {
+			return Entry.Key == Key;
+		});
+		if (Index == INDEX_NONE)
+		{
+			return {};
+		}
+
+		// move to the back, so that the least recently used entry is always first
+		const FEntry Entry = Entries[Index];
+		Entries.RemoveAt(Index);
+		Entries.Add(Entry);
+		return Entry.Transmittance;
+	}
+
+	void Add(const FTransmittanceCacheKey& Key, const FRHITextureData& Transmittance)
+	{
+		check(IsInRenderingThread());
+		Entries.RemoveAll([&Key](const FEntry& Entry) {
+			return Entry.Key == Key;
+		});
+		Entries.Add({ Key, Transmittance });
+
+		const uint64 MaxBytes = static_cast<uint64>(FMath::Max(0, CVarTransmittanceCacheSize.GetValueOnRenderThread())) * 1024 * 1024;
+		uint64 NumBytes = 0;
+		for (const FEntry& Entry : Entries)
+		{
+			NumBytes += Entry.Transmittance.NumBytes;
+		}
+		while (NumBytes > MaxBytes && !Entries.IsEmpty())
+		{
+			NumBytes -= Entries[0].Transmittance.NumBytes;
+			Entries.RemoveAt(0);
+		}
+	}
+
+	virtual void ReleaseRHI() override
+	{
+		Entries.Empty();
+	}
+
+private:
+	struct FEntry
+	{
+		FTransmittanceCacheKey Key;
+		FRHITextureData Transmittance;
+	};
+
+	/**
+	 * The cached entries, the most recently used last.
+	 */
+	TArray<FEntry> Entries;
+};
+
+// declared after GPrecomputeBufferPool, so that cached buffers are released before the pool
+static TGlobalResource<FTransmittanceCache> GTransmittanceCache;
+
 DECLARE_STATS_GROUP(TEXT("Atmosphere Precompute"), STATGROUP_AtmospherePrecompute, STATCAT_Advanced);
 DECLARE_CYCLE_STAT(TEXT("Atmosphere Precompute Execute"), STAT_AtmospherePrecompute_Execute, STATGROUP_AtmospherePrecompute);
 
@@ -362,14 +1354,31 @@ void FAtmospherePrecomputeShaderDispatcher::DispatchRenderThread(
 	FPrecomputedTextureSettings TextureSettings,
 	FPrecomputeContext Ctx,
 	bool GenerateDebugTextures,
-	TFunction<void(FAtmospherePrecomputedTextureData, FAtmospherePrecomputedDebugTextureData)> AsyncCallback)
+	FCallback AsyncCallback,
+	bool CallbackOnGameThread)
 {
-	FAtmospherePrecomputeDebugTextures DebugTextures;
 	TArray<FTextureDataReadback*> DebugReadbacks;
+	TMap<FString, FTextureDataReadback*> StatisticsReadbacks;
 
 	FTextureDataReadback* TransmittanceReadback;
 	FTextureDataReadback* InScatteredLightReadback;
 
+	// completes the dispatch without texture data, so that callers waiting for it don't wait forever
+	auto CompleteWithFailure = [&DebugReadbacks, &StatisticsReadbacks, &AsyncCallback, CallbackOnGameThread]() {
+		for (const auto* DebugReadback : DebugReadbacks)
+		{
+			delete DebugReadback;
+		}
+		for (const auto& [Name, StatisticsReadback] : StatisticsReadbacks)
+		{
+			delete StatisticsReadback;
+		}
+
+		AsyncTask(CallbackOnGameThread ? ENamedThreads::GameThread : ENamedThreads::AnyBackgroundThreadNormalTask, [AsyncCallback]() {
+			AsyncCallback(FAtmospherePrecomputedTextureData(), FAtmospherePrecomputedDebugTextureData());
+		});
+	};
+
 	constexpr auto PixelFormat4 = PF_FloatRGBA;
 	{
 		DECLARE_GPU_STAT(AtmospherePrecompute);
@@ -379,24 +1388,138 @@ void FAtmospherePrecomputeShaderDispatcher::DispatchRenderThread(
 		// initialize all textures
 
 		/// output textures
-		const auto Transmittance = FRHITextureData::Create2D(
+		// debug textures include the intermediate transmittance passes, so they always recompute it
+		const FTransmittanceCacheKey TransmittanceKey = MakeTransmittanceCacheKey(TextureSettings, Ctx);
+		const TOptional<FRHITextureData> CachedTransmittance = GenerateDebugTextures
+			? TOptional<FRHITextureData>()
+			: GTransmittanceCache.Find(TransmittanceKey);
+		const auto Transmittance = CachedTransmittance.IsSet()
+			? CachedTransmittance.GetValue()
+			: FRHITextureData::Create2D(
+				  RHICmdList,
+				  TextureSettings.TransmittanceTextureWidth, TextureSettings.TransmittanceTextureHeight,
+				  PixelFormat4,
+				  TEXT("Transmittance Texture"));
+
+		const FIntVector InScatteredLightSize = TextureSettings.GetInScatteredLightTextureSize();
+		const auto InScatteredLight = TextureSettings.OuterShellOnly
+			? FRHITextureData::Create2D(
+				  RHICmdList,
+				  InScatteredLightSize.Y, InScatteredLightSize.Z,
+				  PixelFormat4,
+				  TEXT("In-Scattered Light Texture"))
+			: FRHITextureData::Create3D(
+				  RHICmdList,
+				  InScatteredLightSize,
+				  PixelFormat4,
+				  TEXT("In-Scattered Light Texture"));
+
+		/// intermediate textures
+		const int ScatteringLUTSize = FMath::Max(2, TextureSettings.ScatteringLUTSize);
+		const auto ScatteringLUT = FRHITextureData::Create2D(
 			RHICmdList,
-			TextureSettings.TransmittanceTextureWidth, TextureSettings.TransmittanceTextureHeight,
-			PixelFormat4,
-			TEXT("Transmittance Texture"));
+			2, ScatteringLUTSize,
+			PF_A32B32G32R32F,
+			TEXT("Scattering LUT"));
+		const auto ScatteringLUTSRV = ScatteringLUT.CreateSRV(RHICmdList);
 
-		const auto InScatteredLight = FRHITextureData::Create3D(
-			RHICmdList,
-			FIntVector(TextureSettings.InScatteredLightTextureSize),
-			PixelFormat4,
-			TEXT("In-Scattered Light Texture"));
+		{
+			// pass 0: scattering LUT
+			TShaderMapRef<FScatteringLUTPrecomputeCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+			if (!Shader.IsValid())
+			{
+				UE_LOG(LogShaders, Error, TEXT("Scattering LUT Precompute shader is not valid"));
+				CompleteWithFailure();
+				return;
+			}
+
+			SetComputePipelineState(RHICmdList, Shader.GetComputeShader());
+
+			SetShaderParametersLegacyCS(RHICmdList, Shader,
+				ScatteringLUT.CreateUAV(RHICmdList), ScatteringLUTSize, Ctx);
+
+			RHICmdList.DispatchComputeShader(FMath::DivideAndRoundUp(ScatteringLUTSize, FScatteringLUTPrecomputeCS::ThreadGroupSize), 1, 1);
+
+			UnsetShaderUAVs(RHICmdList, Shader, Shader.GetComputeShader());
 
+			DEBUG_READBACK(0, ScatteringLUT)
+		}
+
+		if (CachedTransmittance.IsSet())
+		{
+			// pass 1: reuse the transmittance of an earlier precomputation with the same inputs
+		}
+		else if (TextureSettings.BuildTransmittanceFromOpticalDepth)
+		{
+			// pass 1a: optical depth along chords through the atmosphere
+			const int NumChords = FMath::Max(TextureSettings.TransmittanceTextureWidth, TextureSettings.TransmittanceTextureHeight);
+			const int NumChordSamples = 8 * TextureSettings.TransmittanceSampleSteps;
+
+			const auto OpticalDepth = FRHITextureData::Create2D(
+				RHICmdList,
+				NumChordSamples + 1, NumChords,
+				PF_A32B32G32R32F,
+				TEXT("Optical Depth"));
+
+			{
+				TShaderMapRef<FOpticalDepthPrecomputeCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+				if (!Shader.IsValid())
+				{
+					UE_LOG(LogShaders, Error, TEXT("Optical Depth Precompute shader is not valid"));
+					CompleteWithFailure();
+					return;
+				}
+
+				SetComputePipelineState(RHICmdList, Shader.GetComputeShader());
+
+				SetShaderParametersLegacyCS(RHICmdList, Shader,
+					OpticalDepth.CreateUAV(RHICmdList), NumChords, NumChordSamples,
+					ScatteringLUTSRV, ScatteringLUTSize,
+					Ctx);
+
+				RHICmdList.DispatchComputeShader(FMath::DivideAndRoundUp(NumChords, FOpticalDepthPrecomputeCS::ThreadGroupSize), 1, 1);
+
+				UnsetShaderUAVs(RHICmdList, Shader, Shader.GetComputeShader());
+
+				DEBUG_READBACK(1, OpticalDepth)
+			}
+
+			{
+				// pass 1b: transmittance from optical depth
+				TShaderMapRef<FTransmittanceFromOpticalDepthCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+				if (!Shader.IsValid())
+				{
+					UE_LOG(LogShaders, Error, TEXT("Transmittance From Optical Depth shader is not valid"));
+					CompleteWithFailure();
+					return;
+				}
+
+				const FIntVector GroupCount = FComputeShaderUtils::GetGroupCount(
+					FIntVector(TextureSettings.TransmittanceTextureWidth, TextureSettings.TransmittanceTextureHeight, 1),
+					FComputeShaderUtils::kGolden2DGroupSize);
+
+				SetComputePipelineState(RHICmdList, Shader.GetComputeShader());
+
+				SetShaderParametersLegacyCS(RHICmdList, Shader,
+					OpticalDepth.CreateSRV(RHICmdList), NumChords, NumChordSamples,
+					Transmittance.CreateUAV(RHICmdList), Transmittance.Size.X, Transmittance.Size.Y,
+					Ctx);
+
+				RHICmdList.DispatchComputeShader(GroupCount.X, GroupCount.Y, GroupCount.Z);
+
+				UnsetShaderUAVs(RHICmdList, Shader, Shader.GetComputeShader());
+
+				DEBUG_READBACK(1, Transmittance)
+			}
+		}
+		else
 		{
 			// pass 1: transmittance
 			TShaderMapRef<FTransmittancePrecomputeCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
 			if (!Shader.IsValid())
 			{
 				UE_LOG(LogShaders, Error, TEXT("Transmittance Precompute shader is not valid"));
+				CompleteWithFailure();
 				return;
 			}
 
@@ -408,7 +1531,9 @@ void FAtmospherePrecomputeShaderDispatcher::DispatchRenderThread(
 
 			SetShaderParametersLegacyCS(RHICmdList, Shader,
 				Transmittance.CreateUAV(RHICmdList), Transmittance.Size.X, Transmittance.Size.Y,
-				TextureSettings.TransmittanceSampleSteps, Ctx);
+				TextureSettings.TransmittanceSampleSteps,
+				ScatteringLUTSRV, ScatteringLUTSize,
+				Ctx);
 
 			RHICmdList.DispatchComputeShader(GroupCount.X, GroupCount.Y, GroupCount.Z);
 
@@ -417,25 +1542,126 @@ void FAtmospherePrecomputeShaderDispatcher::DispatchRenderThread(
 			DEBUG_READBACK(1, Transmittance)
 		}
 
+		if (!CachedTransmittance.IsSet())
+		{
+			GTransmittanceCache.Add(TransmittanceKey, Transmittance);
+		}
+
+		if (TextureSettings.AdaptiveRefinement && !TextureSettings.OuterShellOnly)
+		{
+			// pass 2: in-scattered light, coarse-to-fine
+			const auto ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
+			const TShaderMapRef<FAdaptiveInScatteredLightPrecomputeCS> CoarseShader(ShaderMap);
+			const TShaderMapRef<FEstimateInScatteredLightRefinementCS> EstimateShader(ShaderMap);
+			const TShaderMapRef<FRefineInScatteredLightPrecomputeCS> RefineShader(ShaderMap);
+			if (!CoarseShader.IsValid() || !EstimateShader.IsValid() || !RefineShader.IsValid())
+			{
+				UE_LOG(LogShaders, Error, TEXT("Adaptive In-Scattered Light Precompute shaders are not valid"));
+				CompleteWithFailure();
+				return;
+			}
+
+			const FIntVector NumBricks = FAdaptiveInScatteredLightPrecomputeCS::GetNumBricks(InScatteredLight.Size);
+			const auto CoarseInScatteredLight = FRHITextureData::Create3D(
+				RHICmdList,
+				NumBricks + FIntVector(1),
+				PixelFormat4,
+				TEXT("Coarse In-Scattered Light"));
+			const auto BrickRefinementFlags = FRHITextureData::Create3D(
+				RHICmdList,
+				NumBricks,
+				PF_R32_UINT,
+				TEXT("Brick Refinement Flags"));
+
+			auto DispatchPass = [&](const TShaderRef<FAdaptiveInScatteredLightPrecomputeCS>& Shader,
+									const FRHITextureData& Output, const FIntVector& GroupCount) {
+				SetComputePipelineState(RHICmdList, Shader.GetComputeShader());
+
+				SetShaderParametersLegacyCS(RHICmdList, Shader,
+					Transmittance.CreateSRV(RHICmdList), Transmittance.Size.X, Transmittance.Size.Y,
+					Output.CreateUAV(RHICmdList), InScatteredLightSize,
+					TextureSettings.InScatteredLightSampleSteps,
+					ScatteringLUTSRV, ScatteringLUTSize,
+					Ctx,
+					CoarseInScatteredLight.CreateSRV(RHICmdList),
+					BrickRefinementFlags.CreateUAV(RHICmdList),
+					BrickRefinementFlags.CreateSRV(RHICmdList),
+					TextureSettings.RefinementThreshold);
+
+				RHICmdList.DispatchComputeShader(GroupCount.X, GroupCount.Y, GroupCount.Z);
+
+				UnsetShaderUAVs(RHICmdList, Shader, Shader.GetComputeShader());
+			};
+
+			// ray march the brick corners, then the center of every brick to find the bricks that can't be interpolated
+			DispatchPass(CoarseShader, CoarseInScatteredLight,
+				FComputeShaderUtils::GetGroupCount(CoarseInScatteredLight.Size, FComputeShaderUtils::kGolden2DGroupSize));
+			DEBUG_READBACK(2, CoarseInScatteredLight)
+			DispatchPass(EstimateShader, CoarseInScatteredLight,
+				FComputeShaderUtils::GetGroupCount(NumBricks, FComputeShaderUtils::kGolden2DGroupSize));
+
+			// one group per brick, plus an extra group along axes whose last texel is past the last full brick
+			DispatchPass(RefineShader, InScatteredLight,
+				FComputeShaderUtils::GetGroupCount(InScatteredLight.Size, FAdaptiveInScatteredLightPrecomputeCS::BrickSize));
+
+			DEBUG_READBACK(2, InScatteredLight)
+		}
+		else
 		{
 			// pass 2: in-scattered light
-			TShaderMapRef<FInScatteredLightPrecomputeCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+			const auto ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
+			TShaderRef<FInScatteredLightPrecomputeCS> Shader;
+			FIntVector GroupCount;
+			if (TextureSettings.OuterShellOnly)
+			{
+				Shader = TShaderMapRef<FOuterShellInScatteredLightPrecomputeCS>(ShaderMap);
+				GroupCount = FComputeShaderUtils::GetGroupCount(
+					FIntVector(InScatteredLight.Size.X, InScatteredLight.Size.Y, 1),
+					FComputeShaderUtils::kGolden2DGroupSize);
+			}
+			else if (TextureSettings.ShareViewRaysAcrossSunAngles)
+			{
+				// one group per view ray and block of sun angles
+				const int32 SunAnglesPerWave = FWaveInScatteredLightPrecomputeCS::GetSunAnglesPerWave();
+				if (SunAnglesPerWave > 0)
+				{
+					FWaveInScatteredLightPrecomputeCS::FPermutationDomain PermutationVector;
+					PermutationVector.Set<FWaveInScatteredLightPrecomputeCS::FSunAnglesPerWave>(SunAnglesPerWave);
+					Shader = TShaderRef<FInScatteredLightPrecomputeCS>::Cast(ShaderMap->GetShader(
+						&FWaveInScatteredLightPrecomputeCS::GetStaticType(), PermutationVector.ToDimensionValueId()));
+					GroupCount = FIntVector(InScatteredLight.Size.X, InScatteredLight.Size.Y,
+						FMath::DivideAndRoundUp(InScatteredLight.Size.Z, SunAnglesPerWave));
+				}
+				if (!Shader.IsValid())
+				{
+					// the wave kernel hasn't been compiled for this wave size
+					Shader = TShaderMapRef<FSharedInScatteredLightPrecomputeCS>(ShaderMap);
+					GroupCount = FIntVector(InScatteredLight.Size.X, InScatteredLight.Size.Y,
+						FMath::DivideAndRoundUp(InScatteredLight.Size.Z, FSharedInScatteredLightPrecomputeCS::SunAnglesPerGroup));
+				}
+			}
+			else
+			{
+				Shader = TShaderMapRef<FInScatteredLightPrecomputeCS>(ShaderMap);
+				GroupCount = FComputeShaderUtils::GetGroupCount(
+					InScatteredLight.Size,
+					FComputeShaderUtils::kGolden2DGroupSize);
+			}
+
 			if (!Shader.IsValid())
 			{
 				UE_LOG(LogShaders, Error, TEXT("In-Scattered Light Precompute shader is not valid"));
+				CompleteWithFailure();
 				return;
 			}
 
-			const FIntVector GroupCount = FComputeShaderUtils::GetGroupCount(
-				FIntVector(TextureSettings.InScatteredLightTextureSize),
-				FComputeShaderUtils::kGolden2DGroupSize);
-
 			SetComputePipelineState(RHICmdList, Shader.GetComputeShader());
 
 			SetShaderParametersLegacyCS(RHICmdList, Shader,
 				Transmittance.CreateSRV(RHICmdList), Transmittance.Size.X, Transmittance.Size.Y,
-				InScatteredLight.CreateUAV(RHICmdList), TextureSettings.InScatteredLightTextureSize,
+				InScatteredLight.CreateUAV(RHICmdList), InScatteredLightSize,
 				TextureSettings.InScatteredLightSampleSteps,
+				ScatteringLUTSRV, ScatteringLUTSize,
 				Ctx);
 
 			RHICmdList.DispatchComputeShader(GroupCount.X, GroupCount.Y, GroupCount.Z);
@@ -445,32 +1671,31 @@ void FAtmospherePrecomputeShaderDispatcher::DispatchRenderThread(
 			DEBUG_READBACK(2, InScatteredLight)
 		}
 
+		STATISTICS_READBACK(Transmittance)
+		STATISTICS_READBACK(InScatteredLight)
+
 		// texture readback
 		TransmittanceReadback = FTextureDataReadback::CreateAndEnqueue(RHICmdList, Transmittance, 0, "Transmittance");
 		InScatteredLightReadback = FTextureDataReadback::CreateAndEnqueue(RHICmdList, InScatteredLight, 0, "In-Scattered Light");
 	}
 
 	// create a lambda that schedules itself to wait without blocking the render thread
-	// until buffer readbacks can be performed
-	auto RunnerFunc = [TransmittanceReadback, InScatteredLightReadback, DebugReadbacks, AsyncCallback](auto&& RunnerFunc) -> void {
-		bool AllReady = TransmittanceReadback->IsReady() && InScatteredLightReadback->IsReady();
-		if (AllReady)
-		{
-			for (const auto* DebugReadback : DebugReadbacks)
-			{
-				if (!DebugReadback->IsReady())
-				{
-					AllReady = false;
-					break;
-				}
-			}
-		}
+	// until buffer readbacks can be performed.
+	// without a rendering thread, e.g. in commandlets, GetRenderThread() is the game thread.
+	auto RunnerFunc = [TransmittanceReadback, InScatteredLightReadback, DebugReadbacks, StatisticsReadbacks, AsyncCallback, CallbackOnGameThread](auto&& RunnerFunc) -> void {
+		auto IsNotReady = [](const FTextureDataReadback* Readback) {
+			return !Readback->IsReady();
+		};
+		const bool AllReady = TransmittanceReadback->IsReady() && InScatteredLightReadback->IsReady()
+			&& !DebugReadbacks.ContainsByPredicate(IsNotReady)
+			&& !Algo::AnyOf(StatisticsReadbacks, [](const auto& Pair) { return !Pair.Value->IsReady(); });
 
 		if (AllReady)
 		{
 			FAtmospherePrecomputedTextureData TextureData;
 			TextureData.TransmittanceTextureData = TransmittanceReadback->Read();
 			TextureData.InScatteredLightTextureData = InScatteredLightReadback->Read();
+			TextureData.Succeeded = true;
 
 			delete TransmittanceReadback;
 			delete InScatteredLightReadback;
@@ -482,20 +1707,26 @@ void FAtmospherePrecomputeShaderDispatcher::DispatchRenderThread(
 					DebugReadback->Name, DebugReadback->Read());
 				delete DebugReadback;
 			}
+			for (const auto& [Name, StatisticsReadback] : StatisticsReadbacks)
+			{
+				DebugTextureData.Statistics.Add(Name, ParseStatistics(StatisticsReadback->Read()));
+				delete StatisticsReadback;
+			}
 
-			AsyncTask(ENamedThreads::GameThread, [AsyncCallback, TextureData, DebugTextureData] {
-				AsyncCallback(TextureData, DebugTextureData);
+			// don't block the render thread with the callback, even if it doesn't need the game thread
+			AsyncTask(CallbackOnGameThread ? ENamedThreads::GameThread : ENamedThreads::AnyBackgroundThreadNormalTask, [AsyncCallback, TextureData = MoveTemp(TextureData), DebugTextureData = MoveTemp(DebugTextureData)]() mutable {
+				AsyncCallback(MoveTemp(TextureData), MoveTemp(DebugTextureData));
 			});
 
 			return;
 		}
 
-		AsyncTask(ENamedThreads::ActualRenderingThread, [RunnerFunc] {
+		AsyncTask(ENamedThreads::GetRenderThread(), [RunnerFunc] {
 			RunnerFunc(RunnerFunc);
 		});
 	};
 
-	AsyncTask(ENamedThreads::ActualRenderingThread, [RunnerFunc] {
+	AsyncTask(ENamedThreads::GetRenderThread(), [RunnerFunc] {
 		RunnerFunc(RunnerFunc);
 	});
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "Rendering/AtmosphereHueRotation.h"
+
+#include "DataDrivenShaderPlatformInfo.h"
+#include "GlobalShader.h"
+#include "RenderGraphUtils.h"
+#include "ShaderParameterStruct.h"
+#include "TextureResource.h"
+#include "Engine/Texture2D.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Engine/TextureRenderTargetVolume.h"
+#include "Engine/VolumeTexture.h"
+
+class FRotateInScatteredLightHueCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FRotateInScatteredLightHueCS);
+	SHADER_USE_PARAMETER_STRUCT(FRotateInScatteredLightHueCS, FGlobalShader);
+
+	class FOuterShellLUT : SHADER_PERMUTATION_BOOL("OUTER_SHELL_LUT");
+	using FPermutationDomain = TShaderPermutationDomain<FOuterShellLUT>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_TEXTURE(Texture, InScatteredLightTextureIn)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture, InScatteredLightTextureOut)
+		SHADER_PARAMETER(float, HueShift)
+		SHADER_PARAMETER(FUintVector3, TextureSize)
+	END_SHADER_PARAMETER_STRUCT()
+
+	/**
+	 * The amount of texels along X and Y rotated by a thread group. Must match the numthreads of RotateInScatteredLightHueCS.
+	 */
+	static constexpr int32 ThreadGroupSize = 8;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FRotateInScatteredLightHueCS,
+	"/SweetAtmosphere/HueShift/RotateInScatteredLightHue.usf",
+	"RotateInScatteredLightHueCS",
+	SF_Compute);
+
+UTexture* FAtmosphereHueRotation::CreateTarget(const UTexture* Source)
+{
+	check(IsInGameThread());
+
+	if (const auto* VolumeTexture = Cast<UVolumeTexture>(Source))
+	{
+		auto* Target = NewObject<UTextureRenderTargetVolume>(GetTransientPackage(), NAME_None, RF_Transient);
+		Target->bCanCreateUAV = true;
+		Target->Init(VolumeTexture->GetSizeX(), VolumeTexture->GetSizeY(), VolumeTexture->GetSizeZ(), PF_FloatRGBA);
+		Target->UpdateResourceImmediate(false);
+		return Target;
+	}
+
+	const auto* Texture2D = CastChecked<UTexture2D>(Source);
+	auto* Target = NewObject<UTextureRenderTarget2D>(GetTransientPackage(), NAME_None, RF_Transient);
+	Target->bCanCreateUAV = true;
+	Target->AddressX = TA_Clamp;
+	Target->AddressY = TA_Clamp;
+	Target->InitCustomFormat(Texture2D->GetSizeX(), Texture2D->GetSizeY(), PF_FloatRGBA, true);
+	Target->UpdateResourceImmediate(false);
+	return Target;
+}
+
+void FAtmosphereHueRotation::Rotate(const UTexture* Source, UTexture* Target, const float HueShift)
+{
+	check(IsInGameThread());
+	check(Source && Target);
+
+	const FTextureResource* SourceResource = Source->GetResource();
+	const FTextureRenderTargetResource* TargetResource = CastChecked<UTextureRenderTarget>(Target)->GameThread_GetRenderTargetResource();
+	if (!SourceResource || !TargetResource)
+	{
+		return;
+	}
+
+	// resources are released on the render thread after this command, so they stay valid until it runs
+	ENQUEUE_RENDER_COMMAND(RotateInScatteredLightHue)
+	([SourceResource, TargetResource, HueShift](FRHICommandListImmediate& RHICmdList) {
+		FRHITexture* SourceRHI = SourceResource->GetTextureRHI();
+		FRHITexture* TargetRHI = TargetResource->GetRenderTargetTexture();
+		if (!SourceRHI || !TargetRHI)
+		{
+			return;
+		}
+
+		FRDGBuilder GraphBuilder(RHICmdList);
+		const FRDGTextureRef Output = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(TargetRHI, TEXT("SweetAtmosphere.RotatedInScatteredLight")));
+		const FIntVector TextureSize = Output->Desc.GetSize();
+
+		FRotateInScatteredLightHueCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FRotateInScatteredLightHueCS::FOuterShellLUT>(!Output->Desc.IsTexture3D());
+		const TShaderMapRef<FRotateInScatteredLightHueCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+
+		auto* Parameters = GraphBuilder.AllocParameters<FRotateInScatteredLightHueCS::FParameters>();
+		Parameters->InScatteredLightTextureIn = SourceRHI;
+		Parameters->InScatteredLightTextureOut = GraphBuilder.CreateUAV(Output);
+		Parameters->HueShift = HueShift;
+		Parameters->TextureSize = FUintVector3(TextureSize.X, TextureSize.Y, FMath::Max(TextureSize.Z, 1));
+
+		FComputeShaderUtils::AddPass(GraphBuilder,
+			RDG_EVENT_NAME("RotateInScatteredLightHue %dx%dx%d", TextureSize.X, TextureSize.Y, TextureSize.Z),
+			Shader, Parameters,
+			FIntVector(
+				FMath::DivideAndRoundUp(TextureSize.X, FRotateInScatteredLightHueCS::ThreadGroupSize),
+				FMath::DivideAndRoundUp(TextureSize.Y, FRotateInScatteredLightHueCS::ThreadGroupSize),
+				FMath::Max(TextureSize.Z, 1)));
+
+		// sampled by renderers from now on
+		GraphBuilder.SetTextureAccessFinal(Output, ERHIAccess::SRVMask);
+		GraphBuilder.Execute();
+	});
+}
@@ -0,0 +1,410 @@
+#include "Rendering/AtmosphereSceneViewExtension.h"
+
+#include "DataDrivenShaderPlatformInfo.h"
+#include "FXRenderingUtils.h"
+#include "GlobalShader.h"
+#include "PixelShaderUtils.h"
+#include "RenderGraphUtils.h"
+#include "SceneRenderTargetParameters.h"
+#include "SceneView.h"
+#include "ShaderParameterStruct.h"
+#include "TextureResource.h"
+#include "Algo/AnyOf.h"
+#include "Algo/SortBy.h"
+#include "Engine/TextureRenderTargetVolume.h"
+
+static TAutoConsoleVariable<int32> CVarResolutionDivisor(
+	TEXT("r.SweetAtmosphere.ResolutionDivisor"),
+	2,
+	TEXT("The factor by which atmospheres rendered by FAtmosphereSceneViewExtension are downsampled.\n")
+	TEXT(" 1: full resolution\n")
+	TEXT(" 2: half resolution (default)\n")
+	TEXT(" 4: quarter resolution"),
+	ECVF_Scalability | ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<int32> CVarTrilinearFiltering(
+	TEXT("r.SweetAtmosphere.TrilinearFiltering"),
+	1,
+	TEXT("Whether atmospheres rendered by FAtmosphereSceneViewExtension sample the precomputed textures linearly.\n")
+	TEXT(" 0: point sampling, cheaper but shows banding at low texture resolutions\n")
+	TEXT(" 1: linear sampling (default)"),
+	ECVF_Scalability | ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarUpsampleDepthSimilarity(
+	TEXT("r.SweetAtmosphere.UpsampleDepthSimilarity"),
+	0.05f,
+	TEXT("The relative depth difference at which atmosphere texels stop contributing to a pixel during upsampling."),
+	ECVF_RenderThreadSafe);
+
+BEGIN_SHADER_PARAMETER_STRUCT(FReducedResolutionAtmosphereCommonParameters, )
+	SHADER_PARAMETER_STRUCT_REF(FViewUniformShaderParameters, View)
+	SHADER_PARAMETER_STRUCT_INCLUDE(FSceneTextureShaderParameters, SceneTextures)
+	SHADER_PARAMETER(int32, ResolutionDivisor)
+	SHADER_PARAMETER(FUintVector2, AtmosphereTextureSize)
+END_SHADER_PARAMETER_STRUCT()
+
+class FRenderAtmosphereCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FRenderAtmosphereCS);
+	SHADER_USE_PARAMETER_STRUCT(FRenderAtmosphereCS, FGlobalShader);
+
+	class FOuterShellLUT : SHADER_PERMUTATION_BOOL("OUTER_SHELL_LUT");
+	class FTrilinearFiltering : SHADER_PERMUTATION_BOOL("ENABLE_TRILINEAR_FILTERING");
+	using FPermutationDomain = TShaderPermutationDomain<FOuterShellLUT, FTrilinearFiltering>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FReducedResolutionAtmosphereCommonParameters, Common)
+		SHADER_PARAMETER_TEXTURE(Texture2D, TransmittanceTexture)
+		SHADER_PARAMETER_TEXTURE(Texture, InScatteredLightTexture)
+		SHADER_PARAMETER(FVector3f, PlanetOrigin)
+		SHADER_PARAMETER(float, PlanetRadius)
+		SHADER_PARAMETER(FVector3f, SunLightDir)
+		SHADER_PARAMETER(float, AtmosphereScale)
+		SHADER_PARAMETER(float, SunIntensity)
+		SHADER_PARAMETER(float, HueShift)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, AtmosphereTextureOut)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, AtmosphereTransmittanceOut)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		// requires the deferred GBuffer for surface normals
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FRenderAtmosphereCS,
+	"/SweetAtmosphere/ReducedResolution/ReducedResolutionAtmosphere.usf",
+	"RenderAtmosphereCS",
+	SF_Compute);
+
+class FUpsampleAtmospherePS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FUpsampleAtmospherePS);
+	SHADER_USE_PARAMETER_STRUCT(FUpsampleAtmospherePS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FReducedResolutionAtmosphereCommonParameters, Common)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, AtmosphereTexture)
+		SHADER_PARAMETER(float, DepthSimilarity)
+		RENDER_TARGET_BINDING_SLOTS()
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FUpsampleAtmospherePS,
+	"/SweetAtmosphere/ReducedResolution/ReducedResolutionAtmosphere.usf",
+	"UpsampleAtmospherePS",
+	SF_Pixel);
+
+class FComputeAerialPerspectiveCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FComputeAerialPerspectiveCS);
+	SHADER_USE_PARAMETER_STRUCT(FComputeAerialPerspectiveCS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_TEXTURE(Texture2D, TransmittanceTexture)
+		SHADER_PARAMETER_TEXTURE(Texture3D, InScatteredLightTexture)
+		SHADER_PARAMETER_SAMPLER(SamplerState, LinearClampedSampler)
+		SHADER_PARAMETER(FVector3f, PlanetOrigin)
+		SHADER_PARAMETER(float, PlanetRadius)
+		SHADER_PARAMETER(FVector3f, SunLightDir)
+		SHADER_PARAMETER(float, AtmosphereScale)
+		SHADER_PARAMETER(float, SunIntensity)
+		SHADER_PARAMETER(float, HueShift)
+		SHADER_PARAMETER(FMatrix44f, ViewToWorld)
+		SHADER_PARAMETER(FVector2f, InvProjectionScale)
+		SHADER_PARAMETER(float, MaxDistance)
+		SHADER_PARAMETER(FUintVector3, VolumeSize)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<float4>, AerialPerspectiveVolumeOut)
+	END_SHADER_PARAMETER_STRUCT()
+
+	/**
+	 * The edge length of a thread group. Must match the numthreads of ComputeAerialPerspectiveCS.
+	 */
+	static constexpr int32 ThreadGroupSize = 4;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FComputeAerialPerspectiveCS,
+	"/SweetAtmosphere/AerialPerspective/AerialPerspectiveVolume.usf",
+	"ComputeAerialPerspectiveCS",
+	SF_Compute);
+
+/**
+ * @return The distance from a position to the edge of an atmosphere, negative if the position lies inside it.
+ */
+static double GetDistanceToAtmosphere(const FVector& Position, const FAtmosphereRenderParameters& Atmosphere)
+{
+	return FVector::Dist(Position, Atmosphere.PlanetOrigin) - Atmosphere.PlanetRadius * (1 + Atmosphere.AtmosphereScale);
+}
+
+FAtmosphereSceneViewExtension::FAtmosphereSceneViewExtension(const FAutoRegister& AutoRegister)
+	: FSceneViewExtensionBase(AutoRegister)
+{
+}
+
+TSharedRef<FAtmosphereSceneViewExtension> FAtmosphereSceneViewExtension::Get()
+{
+	check(IsInGameThread());
+
+	static TSharedPtr<FAtmosphereSceneViewExtension> Instance;
+	if (!Instance)
+	{
+		Instance = FSceneViewExtensions::NewExtension<FAtmosphereSceneViewExtension>();
+	}
+	return Instance.ToSharedRef();
+}
+
+void FAtmosphereSceneViewExtension::SetAtmosphere(const uint32 Id, const FAtmosphereRenderParameters& Parameters)
+{
+	check(IsInGameThread());
+
+	AtmosphereIds.Add(Id);
+	ENQUEUE_RENDER_COMMAND(SetAtmosphere)
+	([this, Id, Parameters](FRHICommandListImmediate&) {
+		Atmospheres_RenderThread.Add(Id, Parameters);
+	});
+}
+
+void FAtmosphereSceneViewExtension::RemoveAtmosphere(const uint32 Id)
+{
+	check(IsInGameThread());
+
+	AtmosphereIds.Remove(Id);
+	ENQUEUE_RENDER_COMMAND(RemoveAtmosphere)
+	([this, Id](FRHICommandListImmediate&) {
+		Atmospheres_RenderThread.Remove(Id);
+	});
+}
+
+void FAtmosphereSceneViewExtension::SetAerialPerspectiveVolume(UTextureRenderTargetVolume* Volume, const float MaxDistance)
+{
+	check(IsInGameThread());
+	check(Volume && Volume->bCanCreateUAV);
+
+	AerialPerspectiveVolume = Volume;
+	ENQUEUE_RENDER_COMMAND(SetAerialPerspectiveVolume)
+	([this, Resource = Volume->GameThread_GetRenderTargetResource(), MaxDistance](FRHICommandListImmediate&) {
+		AerialPerspectiveVolume_RenderThread = Resource;
+		AerialPerspectiveMaxDistance_RenderThread = MaxDistance;
+	});
+}
+
+void FAtmosphereSceneViewExtension::RemoveAerialPerspectiveVolume(const UTextureRenderTargetVolume* Volume)
+{
+	check(IsInGameThread());
+
+	if (AerialPerspectiveVolume != Volume)
+	{
+		return;
+	}
+
+	// enqueued before the volume's resource is released
+	AerialPerspectiveVolume = nullptr;
+	ENQUEUE_RENDER_COMMAND(RemoveAerialPerspectiveVolume)
+	([this](FRHICommandListImmediate&) {
+		AerialPerspectiveVolume_RenderThread = nullptr;
+	});
+}
+
+bool FAtmosphereSceneViewExtension::IsActiveThisFrame_Internal(const FSceneViewExtensionContext& Context) const
+{
+	return !AtmosphereIds.IsEmpty();
+}
+
+void FAtmosphereSceneViewExtension::PostRenderBasePassDeferred_RenderThread(
+	FRDGBuilder& GraphBuilder,
+	FSceneView& InView,
+	const FRenderTargetBindingSlots& RenderTargets,
+	TRDGUniformBufferRef<FSceneTextureUniformParameters> SceneTextures)
+{
+	// lighting is added to the scene color after the base pass, so the in-scattered light can already be added here.
+	// translucency is rendered afterwards, so translucent surfaces in front of the atmosphere aren't covered by it.
+	RenderAtmospheres_RenderThread(GraphBuilder, InView, RenderTargets[0].GetTexture());
+}
+
+void FAtmosphereSceneViewExtension::RenderAtmospheres_RenderThread(
+	FRDGBuilder& GraphBuilder,
+	const FSceneView& View,
+	FRDGTextureRef SceneColor)
+{
+	const bool RenderAnyAtmosphere = Algo::AnyOf(Atmospheres_RenderThread, [](const auto& Pair) {
+		return Pair.Value.RenderAtReducedResolution;
+	});
+	if (!SceneColor || !RenderAnyAtmosphere)
+	{
+		return;
+	}
+
+	RDG_EVENT_SCOPE(GraphBuilder, "SweetAtmosphere");
+
+	const int32 ResolutionDivisor = FMath::Clamp(CVarResolutionDivisor.GetValueOnRenderThread(), 1, 4);
+	const bool TrilinearFiltering = CVarTrilinearFiltering.GetValueOnRenderThread() != 0;
+	const FIntRect& ViewRect = UE::FXRenderingUtils::GetRawViewRectUnsafe(View);
+	const FIntPoint AtmosphereTextureSize = FIntPoint::DivideAndRoundUp(ViewRect.Size(), ResolutionDivisor);
+
+	FRDGTextureRef AtmosphereTexture = GraphBuilder.CreateTexture(
+		FRDGTextureDesc::Create2D(AtmosphereTextureSize, PF_FloatRGBA, FClearValueBinding::Black, TexCreate_ShaderResource | TexCreate_UAV),
+		TEXT("SweetAtmosphere.Atmosphere"));
+	AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(AtmosphereTexture), FVector4f(0, 0, 0, 0));
+
+	FRDGTextureRef AtmosphereTransmittance = GraphBuilder.CreateTexture(
+		FRDGTextureDesc::Create2D(AtmosphereTextureSize, PF_FloatRGBA, FClearValueBinding::White, TexCreate_ShaderResource | TexCreate_UAV),
+		TEXT("SweetAtmosphere.AtmosphereTransmittance"));
+	AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(AtmosphereTransmittance), FVector4f(1, 1, 1, 1));
+
+	FReducedResolutionAtmosphereCommonParameters CommonParameters;
+	CommonParameters.View = View.ViewUniformBuffer;
+	CommonParameters.SceneTextures = GetSceneTextureShaderParameters(
+		CreateSceneTextureUniformBuffer(GraphBuilder, View, ESceneTextureSetupMode::SceneDepth | ESceneTextureSetupMode::GBuffers));
+	CommonParameters.ResolutionDivisor = ResolutionDivisor;
+	CommonParameters.AtmosphereTextureSize = FUintVector2(AtmosphereTextureSize.X, AtmosphereTextureSize.Y);
+
+	const FGlobalShaderMap* ShaderMap = GetGlobalShaderMap(View.GetFeatureLevel());
+	const FVector PreViewTranslation = View.ViewMatrices.GetPreViewTranslation();
+
+	// composite overlapping atmospheres front to back, starting with the one closest to the camera
+	const FVector ViewOrigin = View.ViewMatrices.GetViewOrigin();
+	TArray<const FAtmosphereRenderParameters*, TInlineAllocator<8>> SortedAtmospheres;
+	for (const auto& [Id, Atmosphere] : Atmospheres_RenderThread)
+	{
+		if (Atmosphere.TransmittanceTexture && Atmosphere.InScatteredLightTexture && Atmosphere.RenderAtReducedResolution)
+		{
+			SortedAtmospheres.Add(&Atmosphere);
+		}
+	}
+	Algo::SortBy(SortedAtmospheres, [&ViewOrigin](const FAtmosphereRenderParameters* Atmosphere) {
+		return GetDistanceToAtmosphere(ViewOrigin, *Atmosphere);
+	});
+
+	// render every atmosphere into the same reduced resolution texture
+	for (const FAtmosphereRenderParameters* AtmospherePtr : SortedAtmospheres)
+	{
+		const FAtmosphereRenderParameters& Atmosphere = *AtmospherePtr;
+
+		FRenderAtmosphereCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FRenderAtmosphereCS::FOuterShellLUT>(Atmosphere.OuterShellOnly);
+		PermutationVector.Set<FRenderAtmosphereCS::FTrilinearFiltering>(TrilinearFiltering);
+		const TShaderMapRef<FRenderAtmosphereCS> Shader(ShaderMap, PermutationVector);
+
+		auto* Parameters = GraphBuilder.AllocParameters<FRenderAtmosphereCS::FParameters>();
+		Parameters->Common = CommonParameters;
+		Parameters->TransmittanceTexture = Atmosphere.TransmittanceTexture;
+		Parameters->InScatteredLightTexture = Atmosphere.InScatteredLightTexture;
+		Parameters->PlanetOrigin = FVector3f(Atmosphere.PlanetOrigin + PreViewTranslation);
+		Parameters->PlanetRadius = Atmosphere.PlanetRadius;
+		Parameters->SunLightDir = Atmosphere.SunLightDir;
+		Parameters->AtmosphereScale = Atmosphere.AtmosphereScale;
+		Parameters->SunIntensity = Atmosphere.SunIntensity;
+		Parameters->HueShift = Atmosphere.HueShift;
+		Parameters->AtmosphereTextureOut = GraphBuilder.CreateUAV(AtmosphereTexture);
+		Parameters->AtmosphereTransmittanceOut = GraphBuilder.CreateUAV(AtmosphereTransmittance);
+
+		FComputeShaderUtils::AddPass(GraphBuilder,
+			RDG_EVENT_NAME("RenderAtmosphere %dx%d", AtmosphereTextureSize.X, AtmosphereTextureSize.Y),
+			Shader, Parameters,
+			FComputeShaderUtils::GetGroupCount(AtmosphereTextureSize, FComputeShaderUtils::kGolden2DGroupSize));
+	}
+
+	// upsample and add to the scene color
+	auto* Parameters = GraphBuilder.AllocParameters<FUpsampleAtmospherePS::FParameters>();
+	Parameters->Common = CommonParameters;
+	Parameters->AtmosphereTexture = AtmosphereTexture;
+	Parameters->DepthSimilarity = FMath::Max(CVarUpsampleDepthSimilarity.GetValueOnRenderThread(), UE_KINDA_SMALL_NUMBER);
+	Parameters->RenderTargets[0] = FRenderTargetBinding(SceneColor, ERenderTargetLoadAction::ELoad);
+
+	const TShaderMapRef<FUpsampleAtmospherePS> PixelShader(ShaderMap);
+	FPixelShaderUtils::AddFullscreenPass(GraphBuilder, ShaderMap,
+		RDG_EVENT_NAME("UpsampleAtmosphere"),
+		PixelShader, Parameters, ViewRect,
+		TStaticBlendState<CW_RGB, BO_Add, BF_One, BF_One>::GetRHI());
+}
+
+void FAtmosphereSceneViewExtension::PreRenderView_RenderThread(FRDGBuilder& GraphBuilder, FSceneView& InView)
+{
+	// the volume is shared by all views, so only compute it for the primary view of every family.
+	// scene captures must not overwrite the volume of the views that sample it.
+	if (AerialPerspectiveVolume_RenderThread
+		&& !InView.bIsSceneCapture
+		&& InView.Family->Views[0] == &InView
+		&& InView.IsPerspectiveProjection())
+	{
+		ComputeAerialPerspective_RenderThread(GraphBuilder, InView);
+	}
+}
+
+void FAtmosphereSceneViewExtension::ComputeAerialPerspective_RenderThread(FRDGBuilder& GraphBuilder, const FSceneView& View)
+{
+	FRHITexture* VolumeRHI = AerialPerspectiveVolume_RenderThread->GetRenderTargetTexture();
+	if (!VolumeRHI)
+	{
+		return;
+	}
+
+	RDG_EVENT_SCOPE(GraphBuilder, "SweetAtmosphere");
+
+	// the current planet is the one whose atmosphere is closest to the camera, or contains it
+	const FVector ViewOrigin = View.ViewMatrices.GetViewOrigin();
+	const FAtmosphereRenderParameters* Atmosphere = nullptr;
+	double AtmosphereDistance = UE_BIG_NUMBER;
+	for (const auto& [Id, Candidate] : Atmospheres_RenderThread)
+	{
+		if (!Candidate.TransmittanceTexture || !Candidate.InScatteredLightTexture || Candidate.OuterShellOnly)
+		{
+			continue;
+		}
+
+		const double Distance = GetDistanceToAtmosphere(ViewOrigin, Candidate);
+		if (Distance < AtmosphereDistance)
+		{
+			Atmosphere = &Candidate;
+			AtmosphereDistance = Distance;
+		}
+	}
+
+	const FRDGTextureRef Volume = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(VolumeRHI, TEXT("SweetAtmosphere.AerialPerspectiveVolume")));
+	if (!Atmosphere)
+	{
+		// no aerial perspective
+		AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(Volume), FVector4f(0, 0, 0, 1));
+	}
+	else
+	{
+		const FMatrix& ProjectionMatrix = View.ViewMatrices.GetProjectionMatrix();
+		const FIntVector VolumeSize = Volume->Desc.GetSize();
+
+		auto* Parameters = GraphBuilder.AllocParameters<FComputeAerialPerspectiveCS::FParameters>();
+		Parameters->TransmittanceTexture = Atmosphere->TransmittanceTexture;
+		Parameters->InScatteredLightTexture = Atmosphere->InScatteredLightTexture;
+		Parameters->LinearClampedSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+		Parameters->PlanetOrigin = FVector3f(Atmosphere->PlanetOrigin - ViewOrigin);
+		Parameters->PlanetRadius = Atmosphere->PlanetRadius;
+		Parameters->SunLightDir = Atmosphere->SunLightDir;
+		Parameters->AtmosphereScale = Atmosphere->AtmosphereScale;
+		Parameters->SunIntensity = Atmosphere->SunIntensity;
+		Parameters->HueShift = Atmosphere->HueShift;
+		Parameters->ViewToWorld = FMatrix44f(View.ViewMatrices.GetInvViewMatrix().RemoveTranslation());
+		Parameters->InvProjectionScale = FVector2f(1 / ProjectionMatrix.M[0][0], 1 / ProjectionMatrix.M[1][1]);
+		Parameters->MaxDistance = AerialPerspectiveMaxDistance_RenderThread;
+		Parameters->VolumeSize = FUintVector3(VolumeSize.X, VolumeSize.Y, VolumeSize.Z);
+		Parameters->AerialPerspectiveVolumeOut = GraphBuilder.CreateUAV(Volume);
+
+		const TShaderMapRef<FComputeAerialPerspectiveCS> Shader(GetGlobalShaderMap(View.GetFeatureLevel()));
+		FComputeShaderUtils::AddPass(GraphBuilder,
+			RDG_EVENT_NAME("ComputeAerialPerspective %dx%dx%d", VolumeSize.X, VolumeSize.Y, VolumeSize.Z),
+			Shader, Parameters,
+			FComputeShaderUtils::GetGroupCount(VolumeSize, FComputeAerialPerspectiveCS::ThreadGroupSize));
+	}
+
+	// sampled by materials for the rest of the frame
+	GraphBuilder.SetTextureAccessFinal(Volume, ERHIAccess::SRVMask);
+}
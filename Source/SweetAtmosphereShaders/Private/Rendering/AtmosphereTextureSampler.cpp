@@ -0,0 +1,173 @@
+#include "Rendering/AtmosphereTextureSampler.h"
+
+#include "DataDrivenShaderPlatformInfo.h"
+#include "GlobalShader.h"
+#include "RHIGPUReadback.h"
+#include "RenderGraphUtils.h"
+#include "ShaderParameterStruct.h"
+#include "Async/Async.h"
+
+class FSampleAtmosphereTexturesCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FSampleAtmosphereTexturesCS);
+	SHADER_USE_PARAMETER_STRUCT(FSampleAtmosphereTexturesCS, FGlobalShader);
+
+	class FOuterShellLUT : SHADER_PERMUTATION_BOOL("OUTER_SHELL_LUT");
+	using FPermutationDomain = TShaderPermutationDomain<FOuterShellLUT>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, TransmittanceTexture)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture, InScatteredLightTexture)
+		SHADER_PARAMETER_SAMPLER(SamplerState, LinearClampedSampler)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<float4>, SampleCoordinates)
+		SHADER_PARAMETER(uint32, NumSamples)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<float4>, TransmittanceSamplesOut)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<float4>, InScatteredLightSamplesOut)
+	END_SHADER_PARAMETER_STRUCT()
+
+	/**
+	 * The amount of samples taken by a thread group. Must match the numthreads of SampleAtmosphereTexturesCS.
+	 */
+	static constexpr int32 ThreadGroupSize = 64;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FSampleAtmosphereTexturesCS,
+	"/SweetAtmosphere/Query/SampleAtmosphereTextures.usf",
+	"SampleAtmosphereTexturesCS",
+	SF_Compute);
+
+/**
+ * Creates a texture holding the given texture data.
+ */
+static FRDGTextureRef CreateTexture(FRDGBuilder& GraphBuilder, const FTextureData& TextureData, const TCHAR* Name)
+{
+	FRHITextureCreateDesc Desc = TextureData.IsVolumeTexture()
+		? FRHITextureCreateDesc::Create3D(Name, TextureData.Size.X, TextureData.Size.Y, TextureData.Size.Z, TextureData.PixelFormat)
+		: FRHITextureCreateDesc::Create2D(Name, TextureData.Size.X, TextureData.Size.Y, TextureData.PixelFormat);
+	Desc.SetFlags(ETextureCreateFlags::ShaderResource);
+	const FTextureRHIRef Texture = RHICreateTexture(Desc);
+
+	FRHICommandListImmediate& RHICmdList = GraphBuilder.RHICmdList;
+	const uint32 RowPitch = TextureData.Size.X * GPixelFormats[TextureData.PixelFormat].BlockBytes;
+	if (TextureData.IsVolumeTexture())
+	{
+		const FUpdateTextureRegion3D Region(0, 0, 0, 0, 0, 0, TextureData.Size.X, TextureData.Size.Y, TextureData.Size.Z);
+		RHICmdList.UpdateTexture3D(Texture, 0, Region, RowPitch, RowPitch * TextureData.Size.Y, TextureData.Data.GetData());
+	}
+	else
+	{
+		const FUpdateTextureRegion2D Region(0, 0, 0, 0, TextureData.Size.X, TextureData.Size.Y);
+		RHICmdList.UpdateTexture2D(Texture, 0, Region, RowPitch, TextureData.Data.GetData());
+	}
+
+	return GraphBuilder.RegisterExternalTexture(CreateRenderTarget(Texture, Name));
+}
+
+/**
+ * Reads the samples of a readback that has completed.
+ */
+static TArray<FLinearColor> ReadSamples(FRHIGPUBufferReadback& Readback, const int32 NumSamples)
+{
+	TArray<FLinearColor> Samples;
+	Samples.SetNumUninitialized(NumSamples);
+	const uint32 NumBytes = NumSamples * sizeof(FLinearColor);
+	FMemory::Memcpy(Samples.GetData(), Readback.Lock(NumBytes), NumBytes);
+	Readback.Unlock();
+	return Samples;
+}
+
+TFuture<FAtmosphereTextureSamples> FAtmosphereTextureSampler::SampleFuture(FAtmospherePrecomputedTextureData&& TextureData, TArray<FVector3f> UVWs)
+{
+	check(TextureData.TransmittanceTextureData.PixelFormat == PF_FloatRGBA);
+	check(TextureData.InScatteredLightTextureData.PixelFormat == PF_FloatRGBA);
+
+	const auto Promise = MakeShared<TPromise<FAtmosphereTextureSamples>, ESPMode::ThreadSafe>();
+	TFuture<FAtmosphereTextureSamples> Future = Promise->GetFuture();
+
+	ENQUEUE_RENDER_COMMAND(SampleAtmosphereTextures)
+	([TextureData = MoveTemp(TextureData), UVWs = MoveTemp(UVWs), Promise](FRHICommandListImmediate& RHICmdList) {
+		const int32 NumSamples = UVWs.Num();
+		const bool OuterShellLUT = !TextureData.InScatteredLightTextureData.IsVolumeTexture();
+
+		FSampleAtmosphereTexturesCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FSampleAtmosphereTexturesCS::FOuterShellLUT>(OuterShellLUT);
+		const TShaderMapRef<FSampleAtmosphereTexturesCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+		if (!Shader.IsValid() || NumSamples == 0)
+		{
+			AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [Promise]() {
+				Promise->SetValue(FAtmosphereTextureSamples());
+			});
+			return;
+		}
+
+		TArray<FVector4f> SampleCoordinates;
+		SampleCoordinates.Reserve(NumSamples);
+		for (const FVector3f& UVW : UVWs)
+		{
+			SampleCoordinates.Add(FVector4f(UVW, 0));
+		}
+
+		const uint32 NumBytes = NumSamples * sizeof(FVector4f);
+		const auto TransmittanceReadback = MakeShared<FRHIGPUBufferReadback, ESPMode::ThreadSafe>(TEXT("SweetAtmosphere.TransmittanceSamples"));
+		const auto InScatteredLightReadback = MakeShared<FRHIGPUBufferReadback, ESPMode::ThreadSafe>(TEXT("SweetAtmosphere.InScatteredLightSamples"));
+		{
+			FRDGBuilder GraphBuilder(RHICmdList);
+
+			const FRDGBufferRef Coordinates = CreateStructuredBuffer(GraphBuilder, TEXT("SweetAtmosphere.SampleCoordinates"),
+				sizeof(FVector4f), NumSamples, SampleCoordinates.GetData(), NumBytes);
+			const FRDGBufferRef TransmittanceSamples = GraphBuilder.CreateBuffer(
+				FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector4f), NumSamples), TEXT("SweetAtmosphere.TransmittanceSamples"));
+			const FRDGBufferRef InScatteredLightSamples = GraphBuilder.CreateBuffer(
+				FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector4f), NumSamples), TEXT("SweetAtmosphere.InScatteredLightSamples"));
+
+			auto* Parameters = GraphBuilder.AllocParameters<FSampleAtmosphereTexturesCS::FParameters>();
+			Parameters->TransmittanceTexture = CreateTexture(GraphBuilder, TextureData.TransmittanceTextureData, TEXT("SweetAtmosphere.Transmittance"));
+			Parameters->InScatteredLightTexture = CreateTexture(GraphBuilder, TextureData.InScatteredLightTextureData, TEXT("SweetAtmosphere.InScatteredLight"));
+			Parameters->LinearClampedSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+			Parameters->SampleCoordinates = GraphBuilder.CreateSRV(Coordinates);
+			Parameters->NumSamples = NumSamples;
+			Parameters->TransmittanceSamplesOut = GraphBuilder.CreateUAV(TransmittanceSamples);
+			Parameters->InScatteredLightSamplesOut = GraphBuilder.CreateUAV(InScatteredLightSamples);
+
+			FComputeShaderUtils::AddPass(GraphBuilder,
+				RDG_EVENT_NAME("SampleAtmosphereTextures %d", NumSamples),
+				Shader, Parameters,
+				FComputeShaderUtils::GetGroupCount(NumSamples, FSampleAtmosphereTexturesCS::ThreadGroupSize));
+
+			AddEnqueueCopyPass(GraphBuilder, &TransmittanceReadback.Get(), TransmittanceSamples, NumBytes);
+			AddEnqueueCopyPass(GraphBuilder, &InScatteredLightReadback.Get(), InScatteredLightSamples, NumBytes);
+			GraphBuilder.Execute();
+		}
+
+		// wait for the readbacks without blocking the render thread, see FAtmospherePrecomputeShaderDispatcher
+		auto RunnerFunc = [TransmittanceReadback, InScatteredLightReadback, NumSamples, Promise](auto&& RunnerFunc) -> void {
+			if (TransmittanceReadback->IsReady() && InScatteredLightReadback->IsReady())
+			{
+				FAtmosphereTextureSamples Samples;
+				Samples.Transmittance = ReadSamples(*TransmittanceReadback, NumSamples);
+				Samples.InScatteredLight = ReadSamples(*InScatteredLightReadback, NumSamples);
+				Samples.Succeeded = true;
+
+				AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [Promise, Samples = MoveTemp(Samples)]() mutable {
+					Promise->SetValue(MoveTemp(Samples));
+				});
+				return;
+			}
+
+			AsyncTask(ENamedThreads::GetRenderThread(), [RunnerFunc] {
+				RunnerFunc(RunnerFunc);
+			});
+		};
+
+		AsyncTask(ENamedThreads::GetRenderThread(), [RunnerFunc] {
+			RunnerFunc(RunnerFunc);
+		});
+	});
+
+	return Future;
+}
@@ -18,31 +18,31 @@ struct SWEETATMOSPHERESHADERS_API FParticleProfile
 	/**
 	 * The phase function to apply for this particle profile.
 	 */
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	EPhaseFunction PhaseFunction = EPhaseFunction::None;
 
 	/**
 	 * The scattering coefficients for this particle type at maximum density.
 	 */
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	FVector ScatteringCoefficients = FVector::Zero();
 
 	/**
 	 * The factor f in the density formula exp(-h * f)
 	 */
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float ExponentFactor = 1;
 
 	/**
 	 * The part of the atmosphere over which density should fade in.
 	 */
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float LinearFadeInSize = 0;
 
 	/**
 	 * The part of the atmosphere over which density should fade out.
 	 */
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float LinearFadeOutSize = 1;
 };
 
@@ -59,24 +59,24 @@ struct SWEETATMOSPHERESHADERS_API FAtmosphereSettings
 	 * The atmosphere's size relative to the planet radius.
 	 * A value of 1 makes the atmosphere as high as the planet radius.
 	 */
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float AtmosphereScale = 0.2;
 
 	/**
 	 * The strength of sunlight.
 	 */
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float SunIntensity = 1;
 
 	/**
 	 * The amount of hue shift to apply. A value of 1 equals a hue shift of 360 degrees.
 	 */
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float HueShift = 0;
 
 	/**
 	 * The particle profiles that make up the atmosphere.
 	 */
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	TArray<FParticleProfile> ParticleProfiles;
 };
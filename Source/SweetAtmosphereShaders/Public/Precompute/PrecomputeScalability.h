@@ -0,0 +1,37 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PrecomputeShaderSettings.h"
+
+/**
+ * Scales the quality of precomputed textures by the r.SweetAtmosphere.* scalability console variables,
+ * which are set per effects quality level in the plugin's DefaultScalability.ini, see RegisterQualityLevels:
+ *  - r.SweetAtmosphere.TextureResolutionScale scales all texture resolutions.
+ *  - r.SweetAtmosphere.SampleStepScale scales all ray marching step counts.
+ *  - r.SweetAtmosphere.CompactTextureFormat stores the textures with half the memory.
+ *
+ * Must only be used from the game thread.
+ */
+class SWEETATMOSPHERESHADERS_API FAtmosphereScalability
+{
+public:
+	/**
+	 * Applies the current quality level to texture settings.
+	 *
+	 * @param TextureSettings The texture settings at full quality.
+	 * @return The texture settings to precompute with.
+	 */
+	static FPrecomputedTextureSettings Apply(const FPrecomputedTextureSettings& TextureSettings);
+
+	/**
+	 * Adds the effects quality levels of the plugin's Config/DefaultScalability.ini to the engine's scalability config,
+	 * without overriding values set by the project. Called on module startup, before quality levels are applied.
+	 */
+	static void RegisterQualityLevels();
+
+	/**
+	 * Called once per frame in which the quality of precomputed textures has changed,
+	 * so that live atmospheres can be precomputed again.
+	 */
+	static FSimpleMulticastDelegate& OnChanged();
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PrecomputeShader.h"
+#include "UObject/ObjectKey.h"
+
+#include <atomic>
+
+/**
+ * Identifies a job enqueued with FAtmospherePrecomputeScheduler.
+ */
+struct SWEETATMOSPHERESHADERS_API FAtmospherePrecomputeJobHandle
+{
+	uint64 Id = 0;
+
+	bool IsValid() const
+	{
+		return Id != 0;
+	}
+};
+
+/**
+ * Queues atmosphere precomputations in front of FAtmospherePrecomputeShaderDispatcher,
+ * limiting the amount of concurrent jobs and the GPU memory they hold.
+ *
+ * Queued jobs of the same owner are coalesced, so only the most recent request is precomputed.
+ * Jobs with the lowest priority value are dispatched first, which allows e.g. using camera distance as priority.
+ *
+ * Must only be used from the game thread, except for reading its limits.
+ */
+class SWEETATMOSPHERESHADERS_API FAtmospherePrecomputeScheduler
+{
+public:
+	using FCallback = TFunction<void(FAtmospherePrecomputedTextureData, FAtmospherePrecomputedDebugTextureData)>;
+
+	static FAtmospherePrecomputeScheduler& Get();
+
+	/**
+	 * Enqueues a precomputation.
+	 * Replaces any job of the same owner that hasn't been dispatched yet,
+	 * whose callback will never be called.
+	 *
+	 * @param Owner The object requesting the precomputation. Requests without an owner are never coalesced.
+	 * @param TextureSettings Texture settings.
+	 * @param Ctx Atmosphere generation settings.
+	 * @param GenerateDebugTextures Whether to read intermittent textures into FAtmospherePrecomputedDebugTextureData.
+	 * @param Priority Jobs with a lower value are dispatched first.
+	 * @param Callback The callback to run on the game thread when precomputation has finished,
+	 *                 with FAtmospherePrecomputedTextureData::Succeeded unset if it failed.
+	 * @return A handle to cancel or re-prioritize the job.
+	 */
+	FAtmospherePrecomputeJobHandle Enqueue(
+		FObjectKey Owner,
+		const FPrecomputedTextureSettings& TextureSettings,
+		const FPrecomputeContext& Ctx,
+		bool GenerateDebugTextures,
+		float Priority,
+		FCallback Callback);
+
+	/**
+	 * Cancels a job. Queued jobs are removed, in-flight jobs finish on the GPU
+	 * but their callback isn't called.
+	 *
+	 * @return Whether the job was still queued or in flight.
+	 */
+	bool Cancel(FAtmospherePrecomputeJobHandle Handle);
+
+	/**
+	 * Changes the priority of a job that hasn't been dispatched yet.
+	 */
+	void SetPriority(FAtmospherePrecomputeJobHandle Handle, float Priority);
+
+	/**
+	 * Sets the limits for jobs in flight.
+	 * A single job exceeding MaxBytesInFlight is still dispatched once no other job is in flight.
+	 *
+	 * @param MaxConcurrentJobs The maximum amount of jobs dispatched at the same time.
+	 * @param MaxBytesInFlight The maximum estimated GPU memory of all dispatched jobs.
+	 */
+	void SetLimits(int MaxConcurrentJobs, uint64 MaxBytesInFlight);
+
+	/**
+	 * @return The maximum amount of jobs dispatched at the same time, see SetLimits.
+	 *         Safe to call from any thread, e.g. to limit precomputations that bypass the scheduler.
+	 */
+	int GetMaxConcurrentJobs() const
+	{
+		return MaxConcurrentJobs;
+	}
+
+	/**
+	 * @return The maximum estimated GPU memory of all dispatched jobs, see SetLimits. Safe to call from any thread.
+	 */
+	uint64 GetMaxBytesInFlight() const
+	{
+		return MaxBytesInFlight;
+	}
+
+	/**
+	 * @return The amount of jobs that haven't been dispatched yet.
+	 */
+	int GetNumQueuedJobs() const
+	{
+		return QueuedJobs.Num();
+	}
+
+	/**
+	 * @return The estimated GPU memory required to precompute textures with the given settings.
+	 */
+	static uint64 EstimateBytesInFlight(const FPrecomputedTextureSettings& TextureSettings, bool GenerateDebugTextures);
+
+private:
+	struct FJob
+	{
+		uint64 Id;
+		FObjectKey Owner;
+		FPrecomputedTextureSettings TextureSettings;
+		FPrecomputeContext Ctx;
+		bool GenerateDebugTextures;
+		float Priority;
+		uint64 NumBytes;
+		FCallback Callback;
+	};
+
+	TArray<FJob> QueuedJobs;
+
+	/**
+	 * The estimated GPU memory of every dispatched job, by job id.
+	 * Jobs are only removed once the dispatcher has called back, which it does even if precomputation failed.
+	 */
+	TMap<uint64, uint64> InFlightJobs;
+	TSet<uint64> CanceledInFlightJobs;
+	uint64 BytesInFlight = 0;
+
+	/**
+	 * Only written on the game thread, but may be read from any thread.
+	 */
+	std::atomic<int> MaxConcurrentJobs = 2;
+	std::atomic<uint64> MaxBytesInFlight = 512ull * 1024 * 1024;
+
+	uint64 NextJobId = 1;
+
+	/**
+	 * Dispatches queued jobs as long as the limits allow.
+	 */
+	void Pump();
+
+	void OnJobCompleted(uint64 JobId, const FCallback& Callback,
+		FAtmospherePrecomputedTextureData TextureData, FAtmospherePrecomputedDebugTextureData DebugTextureData);
+};
@@ -2,7 +2,9 @@
 
 #include "CoreMinimal.h"
 #include "PrecomputeShaderSettings.h"
+#include "Async/Future.h"
 #include "Engine/VolumeTexture.h"
+#include "Tasks/Task.h"
 #include "PrecomputeShader.generated.h"
 
 /**
@@ -24,6 +26,85 @@ struct SWEETATMOSPHERESHADERS_API FAtmospherePrecomputedTextures
 	 */
 	UPROPERTY(BlueprintReadOnly)
 	TObjectPtr<UVolumeTexture> InScatteredLightTexture;
+
+	/**
+	 * The in-scattered light texture for rays starting at the top of the atmosphere.
+	 * Set instead of InScatteredLightTexture if precomputed with OuterShellOnly.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	TObjectPtr<UTexture2D> OuterShellInScatteredLightTexture;
+
+	/**
+	 * @return The in-scattered light texture to bind to the material, regardless of its type.
+	 */
+	UTexture* GetInScatteredLightTexture() const
+	{
+		if (OuterShellInScatteredLightTexture)
+		{
+			return OuterShellInScatteredLightTexture;
+		}
+		return InScatteredLightTexture;
+	}
+};
+
+/**
+ * Statistics of the RGB values of a texture or one of its slices.
+ */
+USTRUCT(BlueprintType)
+struct SWEETATMOSPHERESHADERS_API FAtmosphereTextureSliceStatistics
+{
+	GENERATED_BODY()
+
+	/**
+	 * The minimum finite value of each channel.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	FVector Min = FVector::Zero();
+
+	/**
+	 * The maximum finite value of each channel.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	FVector Max = FVector::Zero();
+
+	/**
+	 * The mean finite value of each channel.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	FVector Mean = FVector::Zero();
+
+	/**
+	 * The amount of texels with a NaN or infinite channel.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int NumNonFinite = 0;
+
+	/**
+	 * The amount of texels with a negative channel.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int NumNegative = 0;
+};
+
+/**
+ * Statistics of a precomputed texture, computed on the GPU.
+ */
+USTRUCT(BlueprintType)
+struct SWEETATMOSPHERESHADERS_API FAtmosphereTextureStatistics
+{
+	GENERATED_BODY()
+
+	/**
+	 * The statistics of the entire texture.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	FAtmosphereTextureSliceStatistics Total;
+
+	/**
+	 * The statistics of every Z slice. Contains a single entry for 2D textures.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	TArray<FAtmosphereTextureSliceStatistics> Slices;
 };
 
 /**
@@ -39,8 +120,19 @@ struct SWEETATMOSPHERESHADERS_API FAtmospherePrecomputeDebugTextures
 	 */
 	UPROPERTY(BlueprintReadOnly)
 	TMap<FString, TObjectPtr<UTexture>> DebugTextures;
+
+	/**
+	 * Statistics of the precomputed textures, by their name.
+	 * Only filled if FPrecomputedTextureSettings::ComputeStatistics is set.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	TMap<FString, FAtmosphereTextureStatistics> Statistics;
 };
 
+/**
+ * Texture data read back from the GPU.
+ * Move-only, since the data of an in-scattered light texture can be hundreds of megabytes.
+ */
 struct SWEETATMOSPHERESHADERS_API FTextureData
 {
 	FIntVector Size;
@@ -49,8 +141,14 @@ struct SWEETATMOSPHERESHADERS_API FTextureData
 
 	FTextureData() = default;
 
-	FTextureData(const FIntVector& Size, const EPixelFormat PixelFormat, const TArray<uint8>& Data)
-		: Size(Size), PixelFormat(PixelFormat), Data(Data) {}
+	FTextureData(const FIntVector& Size, const EPixelFormat PixelFormat, TArray<uint8>&& Data)
+		: Size(Size), PixelFormat(PixelFormat), Data(MoveTemp(Data)) {}
+
+	FTextureData(FTextureData&&) = default;
+	FTextureData& operator=(FTextureData&&) = default;
+
+	FTextureData(const FTextureData&) = delete;
+	FTextureData& operator=(const FTextureData&) = delete;
 
 	bool IsVolumeTexture() const
 	{
@@ -59,39 +157,49 @@ struct SWEETATMOSPHERESHADERS_API FTextureData
 
 	UTexture* CreateTexture() const
 	{
-		if (IsVolumeTexture())
-		{
-			return CreateTexture3D();
-		}
-		return CreateTexture2D();
+		void* MipData;
+		UTexture* Texture = CreateLockedTexture(MipData);
+		FMemory::Memcpy(MipData, Data.GetData(), Data.Num());
+		UnlockTexture(Texture);
+		return Texture;
 	}
 
 	UTexture2D* CreateTexture2D() const
 	{
 		check(!IsVolumeTexture());
-
-		auto* Texture = UTexture2D::CreateTransient(Size.X, Size.Y, PixelFormat);
-
-#if WITH_EDITORONLY_DATA
-		Texture->MipGenSettings = TMGS_NoMipmaps;
-#endif
-		Texture->NeverStream = true;
-		Texture->SRGB = 0;
-		Texture->LODGroup = TEXTUREGROUP_Pixels2D;
-
-		uint8* TargetData = static_cast<uint8*>(Texture->GetPlatformData()->Mips[0].BulkData.Lock(LOCK_READ_WRITE));
-		FMemory::Memcpy(TargetData, Data.GetData(), Data.Num());
-		Texture->GetPlatformData()->Mips[0].BulkData.Unlock();
-
-		Texture->UpdateResource();
-		return Texture;
+		return CastChecked<UTexture2D>(CreateTexture());
 	}
 
 	UVolumeTexture* CreateTexture3D() const
 	{
 		check(IsVolumeTexture());
+		return CastChecked<UVolumeTexture>(CreateTexture());
+	}
 
-		auto* Texture = UVolumeTexture::CreateTransient(Size.X, Size.Y, Size.Z, PixelFormat);
+	/**
+	 * Creates an uninitialized transient texture of this size and format, and locks its mip data for writing.
+	 * The mip data can be filled from any thread. Call UnlockTexture on the game thread afterwards to upload it.
+	 *
+	 * @param OutMipData Receives the locked mip data, which has the same size as Data.
+	 * @return The texture, a UVolumeTexture for volume texture data and a UTexture2D otherwise.
+	 */
+	UTexture* CreateLockedTexture(void*& OutMipData) const
+	{
+		FTexturePlatformData* PlatformData;
+		UTexture* Texture;
+		if (IsVolumeTexture())
+		{
+			auto* Texture3D = UVolumeTexture::CreateTransient(Size.X, Size.Y, Size.Z, PixelFormat);
+			PlatformData = Texture3D->GetPlatformData();
+			Texture = Texture3D;
+		}
+		else
+		{
+			auto* Texture2D = UTexture2D::CreateTransient(Size.X, Size.Y, PixelFormat);
+			Texture2D->LODGroup = TEXTUREGROUP_Pixels2D;
+			PlatformData = Texture2D->GetPlatformData();
+			Texture = Texture2D;
+		}
 
 #if WITH_EDITORONLY_DATA
 		Texture->MipGenSettings = TMGS_NoMipmaps;
@@ -99,12 +207,23 @@ struct SWEETATMOSPHERESHADERS_API FTextureData
 		Texture->NeverStream = true;
 		Texture->SRGB = 0;
 
-		uint8* TargetData = static_cast<uint8*>(Texture->GetPlatformData()->Mips[0].BulkData.Lock(LOCK_READ_WRITE));
-		FMemory::Memcpy(TargetData, Data.GetData(), Data.Num());
-		Texture->GetPlatformData()->Mips[0].BulkData.Unlock();
+		OutMipData = PlatformData->Mips[0].BulkData.Lock(LOCK_READ_WRITE);
+		return Texture;
+	}
+
+	/**
+	 * Unlocks the mip data of a texture created by CreateLockedTexture and creates its resource.
+	 * Must be called on the game thread, but only allocates the resource and enqueues its initialization:
+	 * the RHI texture is created with the mip data as its initial data on the render thread.
+	 */
+	static void UnlockTexture(UTexture* Texture)
+	{
+		FTexturePlatformData* PlatformData = Texture->IsA<UVolumeTexture>()
+			? CastChecked<UVolumeTexture>(Texture)->GetPlatformData()
+			: CastChecked<UTexture2D>(Texture)->GetPlatformData();
+		PlatformData->Mips[0].BulkData.Unlock();
 
 		Texture->UpdateResource();
-		return Texture;
 	}
 };
 
@@ -119,6 +238,11 @@ struct SWEETATMOSPHERESHADERS_API FAtmospherePrecomputedTextureData
 	 * The in-scattered light texture data.
 	 */
 	FTextureData InScatteredLightTextureData;
+
+	/**
+	 * Whether precomputation succeeded. If not, e.g. because a shader isn't available, all texture data is empty.
+	 */
+	bool Succeeded = false;
 };
 
 struct SWEETATMOSPHERESHADERS_API FAtmospherePrecomputedDebugTextureData
@@ -127,6 +251,11 @@ struct SWEETATMOSPHERESHADERS_API FAtmospherePrecomputedDebugTextureData
 	 * Debug texture data by texture name.
 	 */
 	TMap<FString, FTextureData> DebugTextureData;
+
+	/**
+	 * Statistics of the precomputed textures by texture name.
+	 */
+	TMap<FString, FAtmosphereTextureStatistics> Statistics;
 };
 
 #define PARTICLE_PROFILE_PARAMETER(ProfileIndex, Type, Name) \
@@ -143,6 +272,7 @@ struct SWEETATMOSPHERESHADERS_API FAtmospherePrecomputedDebugTextureData
 
 #define DEFINE_PRECOMPUTE_CONTEXT_PARAMETERS() \
 	SHADER_PARAMETER(float, AtmosphereScale)   \
+	SHADER_PARAMETER(float, HueShift)          \
 	SHADER_PARAMETER(int, NumParticleProfiles) \
 	PARTICLE_PROFILE_PARAMETERS(0)             \
 	PARTICLE_PROFILE_PARAMETERS(1)             \
@@ -154,29 +284,91 @@ BEGIN_SHADER_PARAMETER_STRUCT(FPrecomputeContext, SWEETATMOSPHERESHADERS_API)
 DEFINE_PRECOMPUTE_CONTEXT_PARAMETERS()
 END_SHADER_PARAMETER_STRUCT()
 
+/**
+ * The result of a precomputation dispatched by FAtmospherePrecomputeShaderDispatcher.
+ * TextureData.Succeeded is unset if precomputation failed.
+ */
+struct SWEETATMOSPHERESHADERS_API FAtmospherePrecomputeResult
+{
+	FAtmospherePrecomputedTextureData TextureData;
+
+	/**
+	 * Only filled if debug textures were requested.
+	 */
+	FAtmospherePrecomputedDebugTextureData DebugTextureData;
+};
+
 /**
  * Static functions to safely dispatch the atmosphere precompute shader.
  */
 class SWEETATMOSPHERESHADERS_API FAtmospherePrecomputeShaderDispatcher
 {
 public:
+	using FCallback = TFunction<void(FAtmospherePrecomputedTextureData, FAtmospherePrecomputedDebugTextureData)>;
+
+	/**
+	 * Dispatches the precomputation. Can be called from any thread.
+	 *
+	 * @param TextureSettings Texture settings.
+	 * @param Ctx Atmosphere generation settings.
+	 * @param GenerateDebugTextures Whether to read intermittent textures into FAtmospherePrecomputedDebugTextureData.
+	 * @param AsyncCallback The callback to run when precomputation has finished.
+	 *                      Always called, with FAtmospherePrecomputedTextureData::Succeeded unset if precomputation failed.
+	 * @param CallbackOnGameThread Whether to run the callback on the game thread,
+	 *                             otherwise it runs on a background worker thread.
+	 */
 	static void Dispatch(
 		FPrecomputedTextureSettings TextureSettings,
 		FPrecomputeContext Ctx,
 		bool GenerateDebugTextures,
-		TFunction<void(FAtmospherePrecomputedTextureData, FAtmospherePrecomputedDebugTextureData)> AsyncCallback);
+		FCallback AsyncCallback,
+		bool CallbackOnGameThread = true);
+
+	/**
+	 * Dispatches the precomputation without involving the game thread.
+	 * Can be called from any thread, e.g. to await many precomputations from worker threads.
+	 * Isn't throttled by FAtmospherePrecomputeScheduler.
+	 *
+	 * @param TextureSettings Texture settings.
+	 * @param Ctx Atmosphere generation settings.
+	 * @param GenerateDebugTextures Whether to read intermittent textures into FAtmospherePrecomputedDebugTextureData.
+	 * @return A future that is fulfilled on a background worker thread, also if precomputation failed.
+	 */
+	static TFuture<FAtmospherePrecomputeResult> DispatchFuture(
+		const FPrecomputedTextureSettings& TextureSettings,
+		const FPrecomputeContext& Ctx,
+		bool GenerateDebugTextures);
+
+	/**
+	 * Launches a task that dispatches the precomputation once all prerequisites have completed,
+	 * and completes when the textures have been read back.
+	 * Can be called from any thread, and isn't throttled by FAtmospherePrecomputeScheduler.
+	 *
+	 * @param TextureSettings Texture settings.
+	 * @param Ctx Atmosphere generation settings.
+	 * @param GenerateDebugTextures Whether to read intermittent textures into FAtmospherePrecomputedDebugTextureData.
+	 * @param Prerequisites Tasks that must complete before the precomputation is dispatched.
+	 * @return The task, whose result can be moved out once it has completed. Completes even if precomputation failed.
+	 */
+	static UE::Tasks::TTask<FAtmospherePrecomputeResult> LaunchTask(
+		const FPrecomputedTextureSettings& TextureSettings,
+		const FPrecomputeContext& Ctx,
+		bool GenerateDebugTextures,
+		const TArray<UE::Tasks::FTask>& Prerequisites = {});
 
 private:
 	static void DispatchGameThread(
 		FPrecomputedTextureSettings TextureSettings,
 		FPrecomputeContext GenerationSettings,
 		bool GenerateDebugTextures,
-		TFunction<void(FAtmospherePrecomputedTextureData, FAtmospherePrecomputedDebugTextureData)> AsyncCallback);
+		FCallback AsyncCallback,
+		bool CallbackOnGameThread);
 
 	static void DispatchRenderThread(
 		FRHICommandListImmediate& RHICmdList,
 		FPrecomputedTextureSettings TextureSettings,
 		FPrecomputeContext Ctx,
 		bool GenerateDebugTextures,
-		TFunction<void(FAtmospherePrecomputedTextureData, FAtmospherePrecomputedDebugTextureData)> AsyncCallback);
+		FCallback AsyncCallback,
+		bool CallbackOnGameThread);
 };
@@ -10,24 +10,145 @@ struct FPrecomputedTextureSettings
 {
 	GENERATED_BODY()
 
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int TransmittanceTextureWidth = 256;
 
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int TransmittanceTextureHeight = 256;
 
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int InScatteredLightTextureSize = 256;
 
+	/**
+	 * Overrides the amount of in-scattered light texels along the height (X), view angle (Y) and sun angle (Z) axes.
+	 * Axes left at 0 use InScatteredLightTextureSize. Outer shell textures ignore X.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FIntVector InScatteredLightTextureDimensions = FIntVector::ZeroVector;
+
 	/**
 	 * The amount of samples to take along the view ray when precomputing transmittance.
 	 */
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int TransmittanceSampleSteps = 25;
 
 	/**
 	 * The amount of samples to take along the view ray when precomputing in-scattered light.
 	 */
-	UPROPERTY(BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int InScatteredLightSampleSteps = 50;
+
+	/**
+	 * The amount of heights at which the particle profiles are evaluated before ray marching.
+	 * Ray marching linearly interpolates between them instead of evaluating every profile per sample.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int ScatteringLUTSize = 512;
+
+	/**
+	 * Whether to build the transmittance texture from optical depth integrated once along a set of chords
+	 * through the atmosphere, instead of ray marching every texel independently.
+	 * Uses one chord per texel of the larger transmittance texture dimension,
+	 * each sampled 8 * TransmittanceSampleSteps times.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool BuildTransmittanceFromOpticalDepth = false;
+
+	/**
+	 * Whether to only precompute in-scattered light for rays starting at the top of the atmosphere.
+	 * This is sufficient for atmospheres that are only ever viewed from outside.
+	 * The in-scattered light texture is then a 2D texture of view angles (X) and sun angles (Y),
+	 * which must be rendered by a material defining OUTER_SHELL_LUT.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool OuterShellOnly = false;
+
+	/**
+	 * Whether to march every view ray of the in-scattered light texture only once
+	 * and reuse its samples for all sun angles.
+	 * Much faster than marching every texel independently, but the result may differ slightly
+	 * due to the different evaluation order, so it must be enabled explicitly.
+	 * If r.SweetAtmosphere.PrecomputeWaveIntrinsics is enabled on GPUs with wave operations,
+	 * samples are shared within a wave instead.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool ShareViewRaysAcrossSunAngles = false;
+
+	/**
+	 * Whether to precompute the in-scattered light texture coarse-to-fine.
+	 * The texture is divided into bricks of 4^3 texels, and only the brick corners are ray marched at first.
+	 * Bricks whose center deviates from the interpolated corners by more than RefinementThreshold are ray marched
+	 * at full quality, all others are interpolated from their corners. Most bricks are smooth, so this is several times faster.
+	 * Takes precedence over ShareViewRaysAcrossSunAngles, and is ignored for outer shell textures.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool AdaptiveRefinement = false;
+
+	/**
+	 * The largest interpolation error of a brick, relative to its in-scattered light, that doesn't require ray marching it.
+	 * See AdaptiveRefinement.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "AdaptiveRefinement"))
+	float RefinementThreshold = 0.01f;
+
+	/**
+	 * Whether to apply the atmosphere's hue shift to the in-scattered light texture
+	 * during precomputation instead of rotating the hue of every rendered pixel.
+	 * Materials rendering baked textures can define HUE_SHIFT_BAKED to skip the rotation entirely.
+	 * Changing the hue shift afterwards rotates the hue of a copy of the in-scattered light texture on the GPU,
+	 * see UAtmosphereMaterialHelper::ResolveHueShift.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool BakeHueShift = false;
+
+	/**
+	 * Whether to store the precomputed textures as PF_FloatR11G11B10 instead of PF_FloatRGBA,
+	 * which halves their memory at the cost of some precision.
+	 * Only affects the created textures, precomputed texture data is always PF_FloatRGBA.
+	 * Ignored for the in-scattered light texture if BakeHueShift is set, since hue rotations produce
+	 * negative channels the unsigned format would clamp, see UseCompactInScatteredLightFormat.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool CompactTextureFormat = false;
+
+	/**
+	 * Whether to compute statistics of the precomputed textures on the GPU
+	 * and return them in FAtmospherePrecomputeDebugTextures.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool ComputeStatistics = false;
+
+	/**
+	 * If non-empty, debug readbacks of volume textures only contain these Z slices.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<int> DebugReadbackSlices;
+
+	/**
+	 * @return The amount of in-scattered light texels along the height, view angle and sun angle axes.
+	 */
+	FIntVector GetInScatteredLightTextureSize() const
+	{
+		return FIntVector(
+			InScatteredLightTextureDimensions.X > 0 ? InScatteredLightTextureDimensions.X : InScatteredLightTextureSize,
+			InScatteredLightTextureDimensions.Y > 0 ? InScatteredLightTextureDimensions.Y : InScatteredLightTextureSize,
+			InScatteredLightTextureDimensions.Z > 0 ? InScatteredLightTextureDimensions.Z : InScatteredLightTextureSize);
+	}
+
+	/**
+	 * @return Whether the in-scattered light texture is stored as PF_FloatR11G11B10, see CompactTextureFormat.
+	 */
+	bool UseCompactInScatteredLightFormat() const
+	{
+		return CompactTextureFormat && !BakeHueShift;
+	}
+
+	/**
+	 * @return The amount of texels of the in-scattered light texture.
+	 */
+	int64 GetNumInScatteredLightTexels() const
+	{
+		const FIntVector Size = GetInScatteredLightTextureSize();
+		return int64(Size.Y) * Size.Z * (OuterShellOnly ? 1 : Size.X);
+	}
 };
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UTexture;
+
+/**
+ * Rotates the hue of in-scattered light textures precomputed with FPrecomputedTextureSettings::BakeHueShift on the GPU,
+ * so a changed hue shift doesn't require precomputing the texture again.
+ */
+class SWEETATMOSPHERESHADERS_API FAtmosphereHueRotation
+{
+public:
+	/**
+	 * Creates a render target the hue of an in-scattered light texture can be rotated into.
+	 * Must be called from the game thread.
+	 *
+	 * @param Source A PF_FloatRGBA volume or outer shell 2D in-scattered light texture.
+	 * @return A PF_FloatRGBA render target of the same dimensions and size.
+	 */
+	static UTexture* CreateTarget(const UTexture* Source);
+
+	/**
+	 * Rotates the hue of an in-scattered light texture into a render target. Must be called from the game thread.
+	 * The pass is enqueued on the render thread, so the target holds the rotated texels before the next frame is rendered.
+	 *
+	 * @param Source The texture to rotate.
+	 * @param Target A render target created by CreateTarget for the source.
+	 * @param HueShift The hue shift to rotate by, in the same units as FAtmosphereSettings::HueShift.
+	 */
+	static void Rotate(const UTexture* Source, UTexture* Target, float HueShift);
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SceneViewExtension.h"
+
+class FTextureRenderTargetResource;
+class UTextureRenderTargetVolume;
+
+/**
+ * Everything required to render an atmosphere outside of a material.
+ */
+struct SWEETATMOSPHERESHADERS_API FAtmosphereRenderParameters
+{
+	/**
+	 * The planet origin, in world space.
+	 */
+	FVector PlanetOrigin = FVector::ZeroVector;
+
+	float PlanetRadius = 1;
+
+	/**
+	 * The direction of light rays coming from the sun.
+	 */
+	FVector3f SunLightDir = FVector3f(0, 0, -1);
+
+	float AtmosphereScale = 0.2f;
+	float SunIntensity = 1;
+
+	/**
+	 * The hue shift to apply, in the same units as FAtmosphereSettings::HueShift.
+	 * Should be 0 if the hue shift has been baked into the in-scattered light texture.
+	 */
+	float HueShift = 0;
+
+	FTextureRHIRef TransmittanceTexture;
+
+	/**
+	 * The in-scattered light texture, either a volume texture or an outer shell 2D texture.
+	 */
+	FTextureRHIRef InScatteredLightTexture;
+
+	/**
+	 * Whether InScatteredLightTexture is an outer shell 2D texture.
+	 * Outer shell textures can't provide aerial perspective.
+	 */
+	bool OuterShellOnly = false;
+
+	/**
+	 * Whether to render the atmosphere itself. Atmospheres rendered by a material
+	 * disable this to only provide aerial perspective.
+	 */
+	bool RenderAtReducedResolution = true;
+};
+
+/**
+ * Renders atmospheres at a reduced resolution after the base pass,
+ * and adds them to the scene color using depth-aware upsampling.
+ * Runs before translucency, which is rendered on top of the atmosphere,
+ * and before temporal anti-aliasing, which accumulates the upsampled result over time.
+ * Overlapping atmospheres are rendered front to back, sorted by the camera's distance to their edge,
+ * and the in-scattered light of every atmosphere is attenuated by the transmittance of the atmospheres in front of it.
+ *
+ * The resolution divisor is controlled by r.SweetAtmosphere.ResolutionDivisor
+ * and texture filtering by r.SweetAtmosphere.TrilinearFiltering, both of which follow the effects quality level.
+ *
+ * Also computes the aerial perspective volume of the atmosphere around the camera before every view family is rendered,
+ * so that materials of objects inside the atmosphere can apply it with a single texture fetch.
+ */
+class SWEETATMOSPHERESHADERS_API FAtmosphereSceneViewExtension : public FSceneViewExtensionBase
+{
+public:
+	FAtmosphereSceneViewExtension(const FAutoRegister& AutoRegister);
+
+	/**
+	 * @return The extension, which is created on first use. Must be called from the game thread.
+	 */
+	static TSharedRef<FAtmosphereSceneViewExtension> Get();
+
+	/**
+	 * Adds or updates an atmosphere to render. Must be called from the game thread.
+	 *
+	 * @param Id A unique id of the atmosphere.
+	 * @param Parameters The atmosphere's render parameters.
+	 */
+	void SetAtmosphere(uint32 Id, const FAtmosphereRenderParameters& Parameters);
+
+	/**
+	 * Stops rendering an atmosphere. Must be called from the game thread.
+	 *
+	 * @param Id The unique id the atmosphere was added with.
+	 */
+	void RemoveAtmosphere(uint32 Id);
+
+	/**
+	 * Starts computing aerial perspective into a volume texture. Must be called from the game thread.
+	 * Only a single volume is computed at a time, for the primary view of every view family.
+	 *
+	 * @param Volume A RTF_RGBA16f render target that can create UAVs, see UAerialPerspectiveVolumeComponent.
+	 * @param MaxDistance The scene depth of the last slice of the volume.
+	 */
+	void SetAerialPerspectiveVolume(UTextureRenderTargetVolume* Volume, float MaxDistance);
+
+	/**
+	 * Stops computing aerial perspective into a volume texture, if it is the current one. Must be called from the game thread.
+	 */
+	void RemoveAerialPerspectiveVolume(const UTextureRenderTargetVolume* Volume);
+
+	// ISceneViewExtension
+	virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override {}
+	virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override {}
+	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override {}
+	virtual void PreRenderView_RenderThread(FRDGBuilder& GraphBuilder, FSceneView& InView) override;
+	virtual void PostRenderBasePassDeferred_RenderThread(FRDGBuilder& GraphBuilder, FSceneView& InView, const FRenderTargetBindingSlots& RenderTargets, TRDGUniformBufferRef<FSceneTextureUniformParameters> SceneTextures) override;
+
+protected:
+	virtual bool IsActiveThisFrame_Internal(const FSceneViewExtensionContext& Context) const override;
+
+private:
+	/**
+	 * The ids of all atmospheres, only accessed from the game thread.
+	 */
+	TSet<uint32> AtmosphereIds;
+
+	/**
+	 * The atmospheres to render, only accessed from the render thread.
+	 */
+	TMap<uint32, FAtmosphereRenderParameters> Atmospheres_RenderThread;
+
+	/**
+	 * The current aerial perspective volume, only accessed from the game thread.
+	 */
+	TWeakObjectPtr<const UTextureRenderTargetVolume> AerialPerspectiveVolume;
+
+	/**
+	 * The aerial perspective volume's resource and depth range, only accessed from the render thread.
+	 */
+	FTextureRenderTargetResource* AerialPerspectiveVolume_RenderThread = nullptr;
+	float AerialPerspectiveMaxDistance_RenderThread = 0;
+
+	void ComputeAerialPerspective_RenderThread(FRDGBuilder& GraphBuilder, const FSceneView& View);
+
+	void RenderAtmospheres_RenderThread(FRDGBuilder& GraphBuilder, const FSceneView& View, FRDGTextureRef SceneColor);
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Precompute/PrecomputeShader.h"
+
+/**
+ * Samples of precomputed textures taken on the GPU, see FAtmosphereTextureSampler.
+ */
+struct SWEETATMOSPHERESHADERS_API FAtmosphereTextureSamples
+{
+	/**
+	 * The transmittance texture sample at every texture coordinate.
+	 */
+	TArray<FLinearColor> Transmittance;
+
+	/**
+	 * The in-scattered light texture sample at every texture coordinate.
+	 */
+	TArray<FLinearColor> InScatteredLight;
+
+	/**
+	 * Whether sampling succeeded. If not, e.g. because the shader isn't available, all samples are empty.
+	 */
+	bool Succeeded = false;
+};
+
+/**
+ * Samples precomputed texture data on the GPU with the linear clamped sampler that atmospheres are rendered with.
+ * Meant for validating CPU lookups like FAtmosphereQuery, not for use at runtime.
+ */
+class SWEETATMOSPHERESHADERS_API FAtmosphereTextureSampler
+{
+public:
+	/**
+	 * Uploads the texture data to the GPU and samples it. Can be called from any thread.
+	 *
+	 * @param TextureData The texture data to sample, which must be PF_FloatRGBA.
+	 * @param UVWs The texture coordinates to sample at. The transmittance texture is sampled at XY,
+	 *             outer shell in-scattered light textures at YZ, see FAtmosphereQuery::SampleInScatteredLightTexture.
+	 * @return A future that is fulfilled on a background worker thread, also if sampling failed.
+	 */
+	static TFuture<FAtmosphereTextureSamples> SampleFuture(FAtmospherePrecomputedTextureData&& TextureData, TArray<FVector3f> UVWs);
+};